@@ -0,0 +1,257 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Heap allocation counting for the viewer. Counting replaces the global operator new, so exactly one
+// translation unit defines ALLOC_TRACKER_IMPLEMENTATION before including this header.
+// With ALLOC_TRACKER_MALLOC on glibc, malloc, calloc and realloc are counted as well, including the ones
+// made by raylib, GLFW and the GL driver; operator new is then counted through malloc.
+
+struct AllocCount
+{
+    unsigned long long count;
+    unsigned long long bytes;
+};
+
+struct AllocCounters
+{
+    std::atomic<unsigned long long> count;
+    std::atomic<unsigned long long> bytes;
+};
+
+// Whole process. Static storage is zeroed before anything runs, so this works from the first allocation
+inline AllocCounters& GetProcessAllocCounters()
+{
+    static AllocCounters counters;
+    return counters;
+}
+
+// Calling thread only
+inline AllocCount& GetThreadAllocCount()
+{
+    static thread_local AllocCount count = { 0, 0 };
+    return count;
+}
+
+inline void CountAllocation(size_t size)
+{
+    AllocCounters& process = GetProcessAllocCounters();
+    process.count.fetch_add(1, std::memory_order_relaxed);
+    process.bytes.fetch_add(size, std::memory_order_relaxed);
+
+    AllocCount& thread = GetThreadAllocCount();
+    thread.count++;
+    thread.bytes += size;
+}
+
+inline AllocCount GetProcessAllocCount()
+{
+    const AllocCounters& process = GetProcessAllocCounters();
+    return AllocCount{ process.count.load(std::memory_order_relaxed), process.bytes.load(std::memory_order_relaxed) };
+}
+
+inline AllocCount operator-(const AllocCount& a, const AllocCount& b)
+{
+    return AllocCount{ a.count - b.count, a.bytes - b.bytes };
+}
+
+//----------------------------------------------------------------------------------
+// Per-frame profile
+//----------------------------------------------------------------------------------
+
+// Parts of a main loop iteration, in the order they run
+enum class AllocPhase
+{
+    Input = 0,      // Window events, input recording and replay
+    Sync,           // Simulation snapshot and commands
+    Load,           // Sheet loading and prefetch requests
+    Scene,          // Sprite, sheet preview and grid
+    Ui,             // Widgets and dialogs
+    Present,        // EndDrawing: buffer swap and event polling
+    Count
+};
+
+inline const char* GetAllocPhaseName(AllocPhase phase)
+{
+    static const char* names[] = { "input", "sync", "load", "scene", "ui", "present" };
+    return names[static_cast<int>(phase)];
+}
+
+// Main thread allocations of each phase of the last finished frame, and of all other threads over it
+class AllocFrameProfile
+{
+private:
+    static const int phaseCount = static_cast<int>(AllocPhase::Count);
+
+    AllocCount current[phaseCount];
+    AllocCount last[phaseCount];
+    AllocPhase phase;
+    AllocCount mark;                // Thread count when the current phase began
+
+    AllocCount frameStartProcess;
+    AllocCount frameStartThread;
+    AllocCount lastOther;
+
+public:
+    AllocFrameProfile() : current{}, last{}, phase(AllocPhase::Input), mark(GetThreadAllocCount()),
+        frameStartProcess(GetProcessAllocCount()), frameStartThread(GetThreadAllocCount()), lastOther{ 0, 0 }
+    {
+    }
+
+    // Everything from here until the next call is charged to phase_
+    void Enter(AllocPhase phase_)
+    {
+        const AllocCount now = GetThreadAllocCount();
+        const AllocCount spent = now - mark;
+
+        current[static_cast<int>(phase)].count += spent.count;
+        current[static_cast<int>(phase)].bytes += spent.bytes;
+
+        mark = now;
+        phase = phase_;
+    }
+
+    // Close the frame, the next one starts in the input phase
+    void EndFrame()
+    {
+        Enter(AllocPhase::Input);
+
+        const AllocCount process = GetProcessAllocCount();
+        const AllocCount thread = GetThreadAllocCount();
+        lastOther = (process - frameStartProcess) - (thread - frameStartThread);
+        frameStartProcess = process;
+        frameStartThread = thread;
+
+        for (int i = 0; i < phaseCount; i++)
+        {
+            last[i] = current[i];
+            current[i] = AllocCount{ 0, 0 };
+        }
+    }
+
+    AllocCount GetPhase(AllocPhase phase_) const
+    {
+        return last[static_cast<int>(phase_)];
+    }
+
+    // Main thread, last frame
+    AllocCount GetFrame() const
+    {
+        AllocCount total = { 0, 0 };
+        for (int i = 0; i < phaseCount; i++)
+        {
+            total.count += last[i].count;
+            total.bytes += last[i].bytes;
+        }
+        return total;
+    }
+
+    // Simulation, prefetch and any other threads, last frame
+    AllocCount GetOtherThreads() const
+    {
+        return lastOther;
+    }
+
+    // Phase of the last frame with the most allocations
+    AllocPhase GetWorstPhase() const
+    {
+        int worst = 0;
+        for (int i = 1; i < phaseCount; i++)
+        {
+            if (last[i].count > last[worst].count) worst = i;
+        }
+        return static_cast<AllocPhase>(worst);
+    }
+};
+
+//----------------------------------------------------------------------------------
+// Counting allocators
+//----------------------------------------------------------------------------------
+
+#if defined(ALLOC_TRACKER_IMPLEMENTATION)
+
+#if defined(ALLOC_TRACKER_MALLOC) && defined(__GLIBC__)
+
+// The executable's malloc takes precedence over libc's for every library in the process
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+
+extern "C" void* malloc(size_t size)
+{
+    CountAllocation(size);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+    CountAllocation(count*size);
+    return __libc_calloc(count, size);
+}
+
+// Growing or moving a block counts as an allocation, freeing one through realloc does not
+extern "C" void* realloc(void* ptr, size_t size)
+{
+    if (size > 0) CountAllocation(size);
+    return __libc_realloc(ptr, size);
+}
+
+static inline void* TrackedAlloc(size_t size)
+{
+    return malloc((size > 0) ? size : 1);
+}
+
+#else
+
+static inline void* TrackedAlloc(size_t size)
+{
+    CountAllocation(size);
+    return malloc((size > 0) ? size : 1);
+}
+
+#endif
+
+void* operator new(size_t size)
+{
+    void* ptr = TrackedAlloc(size);
+    if (ptr == nullptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size)
+{
+    void* ptr = TrackedAlloc(size);
+    if (ptr == nullptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return TrackedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return TrackedAlloc(size);
+}
+
+// Not inlined, or GCC takes free() after an inlined operator new for a mismatched pair
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void TrackedFree(void* ptr)
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr) noexcept { TrackedFree(ptr); }
+void operator delete[](void* ptr) noexcept { TrackedFree(ptr); }
+void operator delete(void* ptr, size_t) noexcept { TrackedFree(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { TrackedFree(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { TrackedFree(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { TrackedFree(ptr); }
+
+#endif // ALLOC_TRACKER_IMPLEMENTATION
@@ -0,0 +1,554 @@
+#pragma once
+
+#include "raylib.h"
+#include "frame_table.h"
+#include "frame_import.h"
+#include "pixel_pipeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define ASEPRITE_HEADER_SIZE 128
+#define ASEPRITE_FRAME_HEADER_SIZE 16
+#define ASEPRITE_MAGIC 0xA5E0
+#define ASEPRITE_FRAME_MAGIC 0xF1FA
+
+#define ASEPRITE_CHUNK_OLD_PALETTE 0x0004
+#define ASEPRITE_CHUNK_LAYER 0x2004
+#define ASEPRITE_CHUNK_CEL 0x2005
+#define ASEPRITE_CHUNK_TAGS 0x2018
+#define ASEPRITE_CHUNK_PALETTE 0x2019
+
+// An .ase/.aseprite file flattened into a sheet, one cell per frame, plus its timing and tags
+struct AsepriteSheet
+{
+    Image sheet = { 0 };          // RGBA8, data is null when loading failed
+    int columns = 0;
+    int rows = 0;
+    int frameCount = 0;
+    int layerCount = 0;
+    int celCount = 0;
+    int threads = 0;
+    std::shared_ptr<FrameTable> frames;
+
+    double parseMs = 0.0;
+    double composeMs = 0.0;
+    double totalMs = 0.0;
+
+    std::string error;
+};
+
+//----------------------------------------------------------------------------------
+// Parsing
+//----------------------------------------------------------------------------------
+
+static inline unsigned int AseU16(const unsigned char* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static inline int AseS16(const unsigned char* p)
+{
+    return static_cast<short>(AseU16(p));
+}
+
+static inline unsigned int AseU32(const unsigned char* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<unsigned int>(p[3]) << 24);
+}
+
+struct AsepriteLayer
+{
+    int type;           // 0 image, 1 group, 2 tilemap
+    int opacity;
+    bool visible;       // Including the visibility of the groups it sits in
+};
+
+struct AsepriteCel
+{
+    int layer;
+    int x;
+    int y;
+    int opacity;
+    int width;
+    int height;
+    int linkedFrame;    // >= 0 when the cel reuses the pixels of another frame
+    bool compressed;
+    std::vector<unsigned char> data;
+};
+
+struct AsepriteFrame
+{
+    int durationMs;
+    std::vector<AsepriteCel> cels;
+};
+
+// Everything read from the file before any pixel is decoded
+struct AsepriteDocument
+{
+    int width;
+    int height;
+    int depth;                  // Bits per pixel: 32 RGBA, 16 grayscale, 8 indexed
+    int transparentIndex;
+    bool layerOpacity;
+
+    std::vector<AsepriteLayer> layers;
+    std::vector<AsepriteFrame> frames;
+    std::vector<Color> palette;
+    bool hasNewPalette;
+    std::vector<FrameTag> tags;
+    std::vector<std::string> tagNames;
+};
+
+class AsepriteReader
+{
+private:
+    AsepriteDocument& document;
+    std::vector<int> groupVisible;  // By child level, while layers are read
+
+    static bool ReadString(const unsigned char* p, const unsigned char* end, std::string* out)
+    {
+        if (p + 2 > end) return false;
+
+        const unsigned int length = AseU16(p);
+        if (p + 2 + length > end) return false;
+
+        out->assign(reinterpret_cast<const char*>(p + 2), length);
+        return true;
+    }
+
+    void ReadLayer(const unsigned char* p, const unsigned char* end)
+    {
+        if (p + 16 > end) return;
+
+        const unsigned int flags = AseU16(p);
+        const int childLevel = static_cast<int>(AseU16(p + 4));
+
+        AsepriteLayer layer;
+        layer.type = static_cast<int>(AseU16(p + 2));
+        layer.opacity = document.layerOpacity ? p[12] : 255;
+
+        const bool parentVisible = (childLevel == 0) || ((childLevel <= static_cast<int>(groupVisible.size())) && groupVisible[childLevel - 1]);
+        layer.visible = ((flags & 1) != 0) && parentVisible;
+
+        groupVisible.resize(childLevel + 1);
+        groupVisible[childLevel] = layer.visible;
+
+        document.layers.push_back(layer);
+    }
+
+    void ReadCel(AsepriteFrame& frame, const unsigned char* p, const unsigned char* end)
+    {
+        if (p + 16 > end) return;
+
+        AsepriteCel cel;
+        cel.layer = static_cast<int>(AseU16(p));
+        cel.x = AseS16(p + 2);
+        cel.y = AseS16(p + 4);
+        cel.opacity = p[6];
+        cel.width = 0;
+        cel.height = 0;
+        cel.linkedFrame = -1;
+        cel.compressed = false;
+
+        const unsigned int type = AseU16(p + 7);
+        p += 16;
+
+        if (type == 1)
+        {
+            if (p + 2 > end) return;
+            cel.linkedFrame = static_cast<int>(AseU16(p));
+        }
+        else if ((type == 0) || (type == 2))
+        {
+            if (p + 4 > end) return;
+
+            cel.width = static_cast<int>(AseU16(p));
+            cel.height = static_cast<int>(AseU16(p + 2));
+            cel.compressed = (type == 2);
+            cel.data.assign(p + 4, end);
+        }
+        else return;    // Tilemap cels are not flattened
+
+        frame.cels.push_back(std::move(cel));
+    }
+
+    void ReadTags(const unsigned char* p, const unsigned char* end)
+    {
+        if (p + 10 > end) return;
+
+        const unsigned int count = AseU16(p);
+        p += 10;
+
+        for (unsigned int i = 0; i < count; i++)
+        {
+            std::string name;
+            if ((p + 17 > end) || !ReadString(p + 17, end, &name)) return;
+
+            FrameTag tag;
+            tag.from = static_cast<int>(AseU16(p));
+            tag.to = static_cast<int>(AseU16(p + 2));
+            tag.direction = static_cast<FrameTagDirection>(std::min(p[4], static_cast<unsigned char>(3)));
+            tag.nameOffset = 0;
+
+            document.tags.push_back(tag);
+            document.tagNames.push_back(name);
+
+            p += 17 + 2 + name.size();
+        }
+    }
+
+    void ReadPalette(const unsigned char* p, const unsigned char* end)
+    {
+        if (p + 20 > end) return;
+
+        const unsigned int size = AseU32(p);
+        const unsigned int first = AseU32(p + 4);
+        const unsigned int last = AseU32(p + 8);
+        if ((size > 256) || (last < first) || (last >= size)) return;
+
+        document.palette.resize(size, BLANK);
+        document.hasNewPalette = true;
+        p += 20;
+
+        for (unsigned int i = first; i <= last; i++)
+        {
+            if (p + 6 > end) return;
+
+            const unsigned int flags = AseU16(p);
+            document.palette[i] = Color{ p[2], p[3], p[4], p[5] };
+            p += 6;
+
+            if ((flags & 1) != 0)
+            {
+                if (p + 2 > end) return;
+                p += 2 + AseU16(p);
+            }
+        }
+    }
+
+    // Only used by files written before the new palette chunk existed
+    void ReadOldPalette(const unsigned char* p, const unsigned char* end)
+    {
+        if (document.hasNewPalette || (p + 2 > end)) return;
+
+        const unsigned int packets = AseU16(p);
+        unsigned int index = 0;
+        p += 2;
+
+        document.palette.resize(256, BLANK);
+
+        for (unsigned int i = 0; i < packets; i++)
+        {
+            if (p + 2 > end) return;
+
+            index += p[0];
+            const unsigned int count = (p[1] == 0) ? 256 : p[1];
+            p += 2;
+
+            for (unsigned int c = 0; (c < count) && (index < 256); c++, index++)
+            {
+                if (p + 3 > end) return;
+                document.palette[index] = Color{ p[0], p[1], p[2], 255 };
+                p += 3;
+            }
+        }
+    }
+
+public:
+    explicit AsepriteReader(AsepriteDocument& document_) : document(document_) {}
+
+    // Stream through the file one frame at a time, keeping cel data compressed for later
+    bool Read(const char* fileName, std::string* error)
+    {
+        FILE* file = fopen(fileName, "rb");
+        if (file == nullptr)
+        {
+            *error = std::string("Cannot open ") + fileName;
+            return false;
+        }
+
+        unsigned char header[ASEPRITE_HEADER_SIZE];
+        if ((fread(header, 1, sizeof(header), file) != sizeof(header)) || (AseU16(header + 4) != ASEPRITE_MAGIC))
+        {
+            *error = std::string(fileName) + " is not an Aseprite file";
+            fclose(file);
+            return false;
+        }
+
+        const unsigned int frameCount = AseU16(header + 6);
+        document.width = static_cast<int>(AseU16(header + 8));
+        document.height = static_cast<int>(AseU16(header + 10));
+        document.depth = static_cast<int>(AseU16(header + 12));
+        document.layerOpacity = (AseU32(header + 14) & 1) != 0;
+        document.transparentIndex = header[28];
+        document.hasNewPalette = false;
+
+        if ((document.depth != 32) && (document.depth != 16) && (document.depth != 8))
+        {
+            *error = std::string(fileName) + ": unsupported color depth";
+            fclose(file);
+            return false;
+        }
+
+        std::vector<unsigned char> buffer;
+        document.frames.resize(frameCount);
+
+        for (unsigned int f = 0; f < frameCount; f++)
+        {
+            unsigned char frameHeader[ASEPRITE_FRAME_HEADER_SIZE];
+            if ((fread(frameHeader, 1, sizeof(frameHeader), file) != sizeof(frameHeader)) || (AseU16(frameHeader + 4) != ASEPRITE_FRAME_MAGIC))
+            {
+                *error = std::string(fileName) + ": truncated frame";
+                fclose(file);
+                return false;
+            }
+
+            const unsigned int frameBytes = AseU32(frameHeader);
+            const unsigned int oldChunks = AseU16(frameHeader + 6);
+            const unsigned int newChunks = AseU32(frameHeader + 12);
+            const unsigned int chunkCount = (newChunks != 0) ? newChunks : oldChunks;
+
+            AsepriteFrame& frame = document.frames[f];
+            frame.durationMs = static_cast<int>(AseU16(frameHeader + 8));
+
+            if (frameBytes < ASEPRITE_FRAME_HEADER_SIZE) continue;
+            buffer.resize(frameBytes - ASEPRITE_FRAME_HEADER_SIZE);
+
+            if (fread(buffer.data(), 1, buffer.size(), file) != buffer.size())
+            {
+                *error = std::string(fileName) + ": truncated frame";
+                fclose(file);
+                return false;
+            }
+
+            const unsigned char* p = buffer.data();
+            const unsigned char* end = p + buffer.size();
+
+            for (unsigned int c = 0; (c < chunkCount) && (p + 6 <= end); c++)
+            {
+                const unsigned int chunkSize = AseU32(p);
+                const unsigned int chunkType = AseU16(p + 4);
+                if ((chunkSize < 6) || (chunkSize > static_cast<size_t>(end - p))) break;
+
+                const unsigned char* data = p + 6;
+                const unsigned char* chunkEnd = p + chunkSize;
+
+                switch (chunkType)
+                {
+                    case ASEPRITE_CHUNK_LAYER: ReadLayer(data, chunkEnd); break;
+                    case ASEPRITE_CHUNK_CEL: ReadCel(frame, data, chunkEnd); break;
+                    case ASEPRITE_CHUNK_TAGS: ReadTags(data, chunkEnd); break;
+                    case ASEPRITE_CHUNK_PALETTE: ReadPalette(data, chunkEnd); break;
+                    case ASEPRITE_CHUNK_OLD_PALETTE: ReadOldPalette(data, chunkEnd); break;
+                    default: break;
+                }
+
+                p = chunkEnd;
+            }
+        }
+
+        fclose(file);
+        return true;
+    }
+};
+
+//----------------------------------------------------------------------------------
+// Compositing
+//----------------------------------------------------------------------------------
+
+// Aseprite's normal blend on straight alpha, opacity scales the source alpha
+static inline Color AseBlendNormal(Color back, Color src, int opacity)
+{
+    const int sa = static_cast<int>(DivRound255(src.a*static_cast<unsigned int>(opacity)));
+    if (sa == 0) return back;
+    if (back.a == 0) return Color{ src.r, src.g, src.b, static_cast<unsigned char>(sa) };
+
+    const int ra = sa + back.a - static_cast<int>(DivRound255(back.a*static_cast<unsigned int>(sa)));
+
+    return Color{
+        static_cast<unsigned char>(back.r + (src.r - back.r)*sa/ra),
+        static_cast<unsigned char>(back.g + (src.g - back.g)*sa/ra),
+        static_cast<unsigned char>(back.b + (src.b - back.b)*sa/ra),
+        static_cast<unsigned char>(ra)
+    };
+}
+
+static inline Color AsePixel(const AsepriteDocument& document, const unsigned char* p)
+{
+    switch (document.depth)
+    {
+        case 32: return Color{ p[0], p[1], p[2], p[3] };
+        case 16: return Color{ p[0], p[0], p[0], p[1] };
+        default:
+        {
+            if ((p[0] == document.transparentIndex) || (p[0] >= document.palette.size())) return BLANK;
+            return document.palette[p[0]];
+        }
+    }
+}
+
+// Blend one cel into its frame cell of the sheet. Compressed cels are zlib streams: the two byte
+// header is skipped and the deflate data inflated with raylib, the trailing checksum is ignored
+static inline bool ComposeCel(const AsepriteDocument& document, const AsepriteCel& cel, int opacity, Color* cell, int stride)
+{
+    const int bytesPerPixel = document.depth/8;
+    const size_t expected = static_cast<size_t>(cel.width)*cel.height*bytesPerPixel;
+
+    const unsigned char* pixels = cel.data.data();
+    unsigned char* inflated = nullptr;
+
+    if (cel.compressed)
+    {
+        if (cel.data.size() < 2) return false;
+
+        int inflatedSize = 0;
+        inflated = DecompressData(cel.data.data() + 2, static_cast<int>(cel.data.size() - 2), &inflatedSize);
+        if ((inflated == nullptr) || (static_cast<size_t>(inflatedSize) < expected))
+        {
+            if (inflated != nullptr) MemFree(inflated);
+            return false;
+        }
+
+        pixels = inflated;
+    }
+    else if (cel.data.size() < expected) return false;
+
+    const int x0 = std::max(0, cel.x);
+    const int y0 = std::max(0, cel.y);
+    const int x1 = std::min(document.width, cel.x + cel.width);
+    const int y1 = std::min(document.height, cel.y + cel.height);
+
+    for (int y = y0; y < y1; y++)
+    {
+        const unsigned char* src = pixels + (static_cast<size_t>(y - cel.y)*cel.width + (x0 - cel.x))*bytesPerPixel;
+        Color* dst = cell + static_cast<size_t>(y)*stride;
+
+        for (int x = x0; x < x1; x++, src += bytesPerPixel) dst[x] = AseBlendNormal(dst[x], AsePixel(document, src), opacity);
+    }
+
+    if (inflated != nullptr) MemFree(inflated);
+    return true;
+}
+
+// Load an Aseprite file: frames are inflated and flattened in parallel, each into its own cell of a
+// near square sheet. Only visible image layers count; every layer blend mode is treated as normal
+inline AsepriteSheet LoadAseprite(const char* fileName)
+{
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point start = Clock::now();
+
+    AsepriteSheet result;
+    AsepriteDocument document;
+
+    AsepriteReader reader(document);
+    const bool read = reader.Read(fileName, &result.error);
+
+    const Clock::time_point parsed = Clock::now();
+    result.parseMs = std::chrono::duration<double, std::milli>(parsed - start).count();
+
+    const int frameCount = static_cast<int>(document.frames.size());
+    if (read && ((frameCount == 0) || (document.width == 0) || (document.height == 0))) result.error = std::string(fileName) + " has no frames";
+
+    if (!result.error.empty())
+    {
+        TraceLog(LOG_WARNING, "ASEPRITE: %s", result.error.c_str());
+        return result;
+    }
+
+    result.frameCount = frameCount;
+    result.layerCount = static_cast<int>(document.layers.size());
+    result.columns = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(frameCount))));
+    result.rows = (frameCount + result.columns - 1)/result.columns;
+    result.threads = std::max(1, std::min(std::min(static_cast<int>(std::thread::hardware_concurrency()), FRAME_IMPORT_MAX_THREADS), frameCount));
+
+    Image& sheet = result.sheet;
+    sheet.width = document.width*result.columns;
+    sheet.height = document.height*result.rows;
+    sheet.mipmaps = 1;
+    sheet.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8;
+    sheet.data = RL_CALLOC(static_cast<size_t>(sheet.width)*sheet.height, sizeof(Color));
+
+    std::vector<int> failedCels(frameCount, 0);
+
+    ParallelForFrames(frameCount, result.threads, [&](int f)
+    {
+        Color* cell = static_cast<Color*>(sheet.data) + static_cast<size_t>(f/result.columns)*document.height*sheet.width + (f % result.columns)*document.width;
+
+        // Bottom layer first
+        for (int layer = 0; layer < result.layerCount; layer++)
+        {
+            const AsepriteLayer& info = document.layers[layer];
+            if (!info.visible || (info.type != 0)) continue;
+
+            for (const AsepriteCel& frameCel : document.frames[f].cels)
+            {
+                if (frameCel.layer != layer) continue;
+
+                const AsepriteCel* cel = &frameCel;
+                int opacity = frameCel.opacity;
+
+                // A linked cel is the cel on the same layer of another frame, pixels, position and opacity included
+                if (frameCel.linkedFrame >= 0)
+                {
+                    cel = nullptr;
+                    if (frameCel.linkedFrame < frameCount)
+                    {
+                        for (const AsepriteCel& linked : document.frames[frameCel.linkedFrame].cels)
+                        {
+                            if ((linked.layer == layer) && (linked.linkedFrame < 0))
+                            {
+                                cel = &linked;
+                                opacity = linked.opacity;
+                            }
+                        }
+                    }
+                }
+
+                if ((cel == nullptr) || !ComposeCel(document, *cel, static_cast<int>(DivRound255(opacity*info.opacity)), cell, sheet.width)) failedCels[f]++;
+            }
+        }
+    });
+
+    result.frames = std::make_shared<FrameTable>();
+    result.frames->Reserve(frameCount, static_cast<int>(document.tags.size()));
+
+    for (int f = 0; f < frameCount; f++)
+    {
+        for (const AsepriteCel& cel : document.frames[f].cels) result.celCount += (cel.layer < result.layerCount) ? 1 : 0;
+
+        FrameEntry entry;
+        entry.source = Rectangle{
+            static_cast<float>((f % result.columns)*document.width),
+            static_cast<float>((f/result.columns)*document.height),
+            static_cast<float>(document.width),
+            static_cast<float>(document.height)
+        };
+        entry.durationMs = static_cast<float>(document.frames[f].durationMs);
+        result.frames->AddFrame(entry);
+    }
+
+    for (size_t t = 0; t < document.tags.size(); t++)
+    {
+        result.frames->AddTag(document.tagNames[t].c_str(), document.tagNames[t].size(), document.tags[t].from, document.tags[t].to, document.tags[t].direction);
+    }
+
+    const int failed = static_cast<int>(std::count_if(failedCels.begin(), failedCels.end(), [](int count) { return count > 0; }));
+
+    const Clock::time_point done = Clock::now();
+    result.composeMs = std::chrono::duration<double, std::milli>(done - parsed).count();
+    result.totalMs = std::chrono::duration<double, std::milli>(done - start).count();
+
+    if (failed > 0) TraceLog(LOG_WARNING, "ASEPRITE: %s: cels could not be decoded in %d frames", fileName, failed);
+    TraceLog(LOG_INFO, "ASEPRITE: %s: %d frames, %d layers, %d tags, parsed in %.2f ms, composed in %.2f ms",
+             fileName, frameCount, result.layerCount, result.frames->GetTagCount(), result.parseMs, result.composeMs);
+
+    return result;
+}
@@ -0,0 +1,734 @@
+#pragma once
+
+#include "raylib.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#define ASSET_MAX_RESULTS 256
+#define ASSET_PARALLEL_SEARCH_MIN 32768
+#define ASSET_RESCAN_INTERVAL_MS 2000   // Directories without a watch are listed again this often
+#define ASSET_RESCANS_PER_POLL 8        // and at most this many of them per Poll()
+
+struct AssetMatch
+{
+    unsigned int id;
+    int score;
+};
+
+// In-memory index of every image below a root directory, built by parallel crawler threads and
+// kept fresh through inotify on Linux. Queries run on the UI thread once IsReady() returns true.
+// Directories the kernel would not watch, e.g. past max_user_watches, are rescanned instead, and
+// the whole tree is crawled again when the event queue overflows
+class AssetIndex
+{
+private:
+    // Paths relative to the root, NUL-terminated and packed back to back
+    std::vector<char> names;
+    std::vector<unsigned int> offsets;
+    std::vector<unsigned short> nameStarts;  // Where the file name begins inside each path
+    std::vector<unsigned char> removed;
+    unsigned int liveCount;
+
+    std::map<std::string, unsigned int> paths;     // Live entries by path, sorted so a directory is a prefix range
+    std::set<std::string> directories;              // Every directory crawled, relative to root
+
+    std::string root;
+    std::thread builder;
+    std::atomic<bool> building;
+    std::atomic<bool> ready;
+    float buildMs;
+
+    // Results of the last query, reused when the next query only appends characters
+    std::string lastQuery;
+    std::string queryScratch;
+    unsigned int lastVersion;
+    unsigned int version;
+    std::vector<unsigned int> candidates;
+    std::vector<AssetMatch> results;
+    float searchMs;
+
+    int inotifyFd;
+    std::unordered_map<int, std::string> watches;  // Watch descriptor -> directory relative to root
+    std::vector<std::string> unwatched;             // Directories inotify_add_watch() failed on
+    size_t rescanNext;
+    std::chrono::steady_clock::time_point lastRescan;
+    unsigned int watchFailures;
+    unsigned int overflows;
+
+    // Output of one crawler thread, merged into the index when the crawl ends
+    struct CrawlBatch
+    {
+        std::vector<char> names;
+        std::vector<unsigned int> offsets;
+        std::vector<std::pair<int, std::string>> watches;
+        std::vector<std::string> directories;
+        std::vector<std::string> unwatched;
+    };
+
+    static std::string Join(const std::string& dir, const char* name)
+    {
+        return dir.empty() ? std::string(name) : dir + "/" + name;
+    }
+
+    static bool IsSeparator(char c)
+    {
+        return (c == '/') || (c == '\\') || (c == '_') || (c == '-') || (c == '.') || (c == ' ');
+    }
+
+    static char Lower(char c)
+    {
+        return ((c >= 'A') && (c <= 'Z')) ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+
+    // NOTE: raylib's IsFileExtension() uses static buffers, this is safe to call from the crawler threads
+    static bool IsImageFile(const char* name)
+    {
+        static const char* extensions[] = { "png", "bmp", "tga", "gif", "jpg", "jpeg", "qoi", "ase", "aseprite" };
+
+        const char* dot = strrchr(name, '.');
+        if (dot == nullptr) return false;
+
+        for (const char* extension : extensions)
+        {
+            const char* a = dot + 1;
+            const char* b = extension;
+            while ((*a != '\0') && (Lower(*a) == *b)) { a++; b++; }
+            if ((*a == '\0') && (*b == '\0')) return true;
+        }
+
+        return false;
+    }
+
+    // Greedy subsequence match, -1 when the query does not match; consecutive characters,
+    // word starts and hits inside the file name score higher
+    static int FuzzyScore(const char* query, const char* text, int nameStart)
+    {
+        int score = 0;
+        int previous = -2;
+        int q = 0;
+        int i = 0;
+
+        for (; (text[i] != '\0') && (query[q] != '\0'); i++)
+        {
+            if (Lower(text[i]) != query[q]) continue;
+
+            int bonus = 1;
+            if (i == previous + 1) bonus += 5;
+            if ((i == 0) || IsSeparator(text[i - 1])) bonus += 8;
+            if (i >= nameStart) bonus += 2;
+
+            score += bonus;
+            previous = i;
+            q++;
+        }
+
+        if (query[q] != '\0') return -1;
+
+        // Prefer shorter paths among equal matches
+        while (text[i] != '\0') i++;
+        return score*64 + (63 - std::min(i, 63));
+    }
+
+    void Append(std::vector<char>& arena, std::vector<unsigned int>& starts, const std::string& path)
+    {
+        starts.push_back(static_cast<unsigned int>(arena.size()));
+        arena.insert(arena.end(), path.begin(), path.end());
+        arena.push_back('\0');
+    }
+
+    void AddEntry(const std::string& path)
+    {
+        // A file created while its directory was being crawled is both listed and reported
+        if (paths.count(path) > 0) return;
+        paths.emplace(path, static_cast<unsigned int>(offsets.size()));
+
+        Append(names, offsets, path);
+
+        const size_t slash = path.find_last_of('/');
+        nameStarts.push_back(static_cast<unsigned short>(std::min<size_t>((slash == std::string::npos) ? 0 : slash + 1, 0xFFFF)));
+        removed.push_back(0);
+        liveCount++;
+    }
+
+    bool IsDirectory(const std::string& path, const struct dirent* entry, bool& isLink) const
+    {
+#if defined(_DIRENT_HAVE_D_TYPE)
+        if (entry->d_type != DT_UNKNOWN)
+        {
+            isLink = (entry->d_type == DT_LNK);
+            return (entry->d_type == DT_DIR);
+        }
+#else
+        (void)entry;
+#endif
+        const std::string fullPath = root + "/" + path;
+        struct stat info;
+#if defined(_WIN32)
+        isLink = false;
+        if (stat(fullPath.c_str(), &info) != 0) return false;
+#else
+        if (lstat(fullPath.c_str(), &info) != 0) return false;
+        isLink = S_ISLNK(info.st_mode);
+#endif
+        return S_ISDIR(info.st_mode);
+    }
+
+    void Watch(const std::string& dir, CrawlBatch& batch)
+    {
+#if defined(__linux__)
+        if (inotifyFd < 0) return;
+
+        const int wd = inotify_add_watch(inotifyFd, (root + "/" + dir).c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR);
+        if (wd >= 0) batch.watches.emplace_back(wd, dir);
+        else batch.unwatched.push_back(dir);
+#else
+        (void)dir;
+        (void)batch;
+#endif
+    }
+
+    // List one directory: images go into the batch, subdirectories are returned for further crawling.
+    // A crawl also watches the directory, a rescan only lists it again; false if it cannot be opened
+    bool ScanDirectory(const std::string& dir, CrawlBatch& batch, std::vector<std::string>& subdirs, bool crawl = true)
+    {
+        // Watch before reading so nothing created in between is missed
+        if (crawl)
+        {
+            Watch(dir, batch);
+            batch.directories.push_back(dir);
+        }
+
+        DIR* handle = opendir(dir.empty() ? root.c_str() : (root + "/" + dir).c_str());
+        if (handle == nullptr) return false;
+
+        while (const struct dirent* entry = readdir(handle))
+        {
+            // Skips ".", ".." and hidden folders such as .git
+            if (entry->d_name[0] == '.') continue;
+
+            const std::string path = Join(dir, entry->d_name);
+            bool isLink = false;
+
+            if (IsDirectory(path, entry, isLink))
+            {
+                if (!isLink) subdirs.push_back(path);
+            }
+            else if (!isLink && IsImageFile(entry->d_name))
+            {
+                Append(batch.names, batch.offsets, path);
+            }
+        }
+
+        closedir(handle);
+        return true;
+    }
+
+    void Merge(CrawlBatch& batch)
+    {
+        for (unsigned int offset : batch.offsets) AddEntry(std::string(batch.names.data() + offset));
+        for (std::pair<int, std::string>& watch : batch.watches) watches[watch.first] = std::move(watch.second);
+        for (std::string& dir : batch.directories) directories.insert(std::move(dir));
+
+        watchFailures += static_cast<unsigned int>(batch.unwatched.size());
+        for (std::string& dir : batch.unwatched) unwatched.push_back(std::move(dir));
+    }
+
+    // Index a tree on the calling thread, for directories that appear after the crawl; they are usually small
+    void CrawlTree(const std::string& path)
+    {
+        CrawlBatch batch;
+        std::vector<std::string> pending {path};
+        std::vector<std::string> subdirs;
+
+        while (!pending.empty())
+        {
+            const std::string dir = pending.back();
+            pending.pop_back();
+
+            subdirs.clear();
+            ScanDirectory(dir, batch, subdirs);
+            pending.insert(pending.end(), subdirs.begin(), subdirs.end());
+        }
+
+        Merge(batch);
+    }
+
+    static bool HasPrefix(const std::string& text, const std::string& prefix)
+    {
+        return text.compare(0, prefix.size(), prefix) == 0;
+    }
+
+    // Directly inside dir, not further down
+    static bool IsChild(const std::string& path, const std::string& prefix)
+    {
+        return HasPrefix(path, prefix) && (path.find('/', prefix.size()) == std::string::npos);
+    }
+
+    // Drop a file, or a directory with everything below it; returns true if anything was indexed there
+    bool RemovePath(const std::string& path)
+    {
+        bool changed = false;
+
+        std::map<std::string, unsigned int>::iterator exact = paths.find(path);
+        if (exact != paths.end())
+        {
+            removed[exact->second] = 1;
+            liveCount--;
+            paths.erase(exact);
+            changed = true;
+        }
+
+        const std::string prefix = path + "/";
+        for (std::map<std::string, unsigned int>::iterator it = paths.lower_bound(prefix); (it != paths.end()) && HasPrefix(it->first, prefix); )
+        {
+            removed[it->second] = 1;
+            liveCount--;
+            it = paths.erase(it);
+            changed = true;
+        }
+
+        const bool wasDirectory = (directories.erase(path) > 0);
+        for (std::set<std::string>::iterator it = directories.lower_bound(prefix); (it != directories.end()) && HasPrefix(*it, prefix); ) it = directories.erase(it);
+
+        // A directory moved out of the tree keeps reporting under its old path until its watches go
+        for (std::unordered_map<int, std::string>::iterator it = watches.begin(); wasDirectory && (it != watches.end()); )
+        {
+            if ((it->second == path) || HasPrefix(it->second, prefix))
+            {
+#if defined(__linux__)
+                inotify_rm_watch(inotifyFd, it->first);
+#endif
+                it = watches.erase(it);
+            }
+            else ++it;
+        }
+
+        unwatched.erase(std::remove_if(unwatched.begin(), unwatched.end(), [&path, &prefix](const std::string& dir)
+        {
+            return (dir == path) || HasPrefix(dir, prefix);
+        }), unwatched.end());
+
+        return changed;
+    }
+
+    // Bring an unwatched directory up to date with what is on disk; returns true if the index changed
+    bool RescanDirectory(const std::string& dir)
+    {
+        CrawlBatch batch;
+        std::vector<std::string> subdirs;
+
+        if (!ScanDirectory(dir, batch, subdirs, false)) return !dir.empty() && RemovePath(dir);
+
+        std::vector<std::string> files;
+        for (unsigned int offset : batch.offsets) files.emplace_back(batch.names.data() + offset);
+        std::sort(files.begin(), files.end());
+        std::sort(subdirs.begin(), subdirs.end());
+
+        const std::string prefix = dir.empty() ? std::string() : dir + "/";
+        bool changed = false;
+
+        // Files that went away
+        for (std::map<std::string, unsigned int>::iterator it = paths.lower_bound(prefix); (it != paths.end()) && HasPrefix(it->first, prefix); )
+        {
+            if (IsChild(it->first, prefix) && !std::binary_search(files.begin(), files.end(), it->first))
+            {
+                removed[it->second] = 1;
+                liveCount--;
+                it = paths.erase(it);
+                changed = true;
+            }
+            else ++it;
+        }
+
+        for (const std::string& file : files)
+        {
+            if (paths.count(file) > 0) continue;
+            AddEntry(file);
+            changed = true;
+        }
+
+        // Subdirectories that went away take their entries along, new ones are crawled
+        std::vector<std::string> gone;
+        for (std::set<std::string>::iterator it = directories.lower_bound(prefix); (it != directories.end()) && HasPrefix(*it, prefix); ++it)
+        {
+            if (!it->empty() && IsChild(*it, prefix) && !std::binary_search(subdirs.begin(), subdirs.end(), *it)) gone.push_back(*it);
+        }
+        for (const std::string& subdir : gone) changed = RemovePath(subdir) || changed;
+
+        for (const std::string& subdir : subdirs)
+        {
+            if (directories.count(subdir) > 0) continue;
+            CrawlTree(subdir);
+            changed = true;
+        }
+
+        return changed;
+    }
+
+    void Crawl()
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        // Directories waiting to be listed, shared by all crawler threads
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::vector<std::string> pending {std::string()};
+        int active = 0;
+
+        const int threadCount = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<CrawlBatch> batches(threadCount);
+        std::vector<std::thread> threads;
+
+        for (int t = 0; t < threadCount; t++)
+        {
+            threads.emplace_back([this, &mutex, &wake, &pending, &active, &batches, t]()
+            {
+                std::vector<std::string> subdirs;
+                std::unique_lock<std::mutex> lock(mutex);
+
+                for (;;)
+                {
+                    // Others still listing may find more work, the crawl is over once nobody is
+                    wake.wait(lock, [&pending, &active]() { return !pending.empty() || (active == 0); });
+                    if (pending.empty()) break;
+
+                    const std::string dir = std::move(pending.back());
+                    pending.pop_back();
+                    active++;
+
+                    lock.unlock();
+                    subdirs.clear();
+                    ScanDirectory(dir, batches[t], subdirs);
+                    lock.lock();
+
+                    for (std::string& subdir : subdirs) pending.push_back(std::move(subdir));
+                    active--;
+                    wake.notify_all();
+                }
+            });
+        }
+
+        for (std::thread& thread : threads) thread.join();
+
+        for (CrawlBatch& batch : batches) Merge(batch);
+
+        buildMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void Score(const char* query, const unsigned int* ids, size_t count, std::vector<AssetMatch>& out) const
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const unsigned int id = ids[i];
+            if (removed[id]) continue;
+
+            const int score = FuzzyScore(query, names.data() + offsets[id], nameStarts[id]);
+            if (score >= 0) out.push_back(AssetMatch{id, score});
+        }
+    }
+
+    void Reset()
+    {
+        names.clear();
+        offsets.clear();
+        nameStarts.clear();
+        removed.clear();
+        liveCount = 0;
+        paths.clear();
+        directories.clear();
+        watches.clear();
+        unwatched.clear();
+        rescanNext = 0;
+        lastRescan = std::chrono::steady_clock::now();
+        watchFailures = 0;
+        lastQuery.clear();
+        candidates.clear();
+        results.clear();
+        version++;
+
+#if defined(__linux__)
+        if (inotifyFd >= 0) close(inotifyFd);
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+    }
+
+public:
+    AssetIndex() : liveCount(0), building(false), ready(false), buildMs(0.0f), lastVersion(0), version(1), searchMs(0.0f), inotifyFd(-1),
+        rescanNext(0), watchFailures(0), overflows(0) {}
+
+    ~AssetIndex()
+    {
+        if (builder.joinable()) builder.join();
+
+#if defined(__linux__)
+        if (inotifyFd >= 0) close(inotifyFd);
+#endif
+    }
+
+    AssetIndex(const AssetIndex&) = delete;
+    AssetIndex& operator=(const AssetIndex&) = delete;
+
+    // Start crawling a directory tree in the background, replacing the current index
+    bool Build(const char* rootPath)
+    {
+        if (building.load() || !DirectoryExists(rootPath)) return false;
+        if (builder.joinable()) builder.join();
+
+        ready = false;
+        building = true;
+
+        root = rootPath;
+        while ((root.size() > 1) && ((root.back() == '/') || (root.back() == '\\'))) root.pop_back();
+
+        Reset();
+
+        builder = std::thread([this]()
+        {
+            Crawl();
+            building = false;
+            ready = true;
+        });
+
+        return true;
+    }
+
+    bool IsBuilding() const
+    {
+        return building.load();
+    }
+
+    bool IsReady() const
+    {
+        return ready.load();
+    }
+
+    float GetBuildMs() const
+    {
+        return buildMs;
+    }
+
+    float GetSearchMs() const
+    {
+        return searchMs;
+    }
+
+    unsigned int GetCount() const
+    {
+        return ready ? liveCount : 0;
+    }
+
+    const char* GetRoot() const
+    {
+        return root.c_str();
+    }
+
+    // Path relative to the root
+    const char* GetPath(unsigned int id) const
+    {
+        return names.data() + offsets[id];
+    }
+
+    const char* GetFileName(unsigned int id) const
+    {
+        return names.data() + offsets[id] + nameStarts[id];
+    }
+
+    std::string GetFullPath(unsigned int id) const
+    {
+        return root + "/" + GetPath(id);
+    }
+
+    // Apply pending file system changes, returns true if the index changed. Call it every frame, not only while
+    // the index is shown: the kernel drops events once its queue is full
+    bool Poll()
+    {
+#if defined(__linux__)
+        if (!ready || (inotifyFd < 0)) return false;
+
+        alignas(struct inotify_event) char buffer[16*1024];
+        bool changed = false;
+        bool overflowed = false;
+
+        while (!overflowed)
+        {
+            const ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+            if (length <= 0) break;
+
+            for (ssize_t i = 0; i < length; )
+            {
+                const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(buffer + i);
+                i += sizeof(struct inotify_event) + event->len;
+
+                // Events were lost, only a new crawl can tell what changed
+                if (event->mask & IN_Q_OVERFLOW)
+                {
+                    overflowed = true;
+                    break;
+                }
+
+                if (event->mask & IN_IGNORED)
+                {
+                    watches.erase(event->wd);
+                    continue;
+                }
+
+                std::unordered_map<int, std::string>::const_iterator watch = watches.find(event->wd);
+                if ((watch == watches.end()) || (event->len == 0) || (event->name[0] == '.')) continue;
+
+                const std::string path = Join(watch->second, event->name);
+
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                {
+                    if (event->mask & IN_ISDIR) CrawlTree(path);
+                    else if (IsImageFile(event->name)) AddEntry(path);
+                }
+                else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+                {
+                    // A directory takes everything below it along
+                    RemovePath(path);
+                }
+
+                changed = true;
+            }
+        }
+
+        if (overflowed)
+        {
+            overflows++;
+            const std::string rootPath = root;
+            Build(rootPath.c_str());
+            return true;
+        }
+
+        // Directories without a watch are listed again now and then, a few per call
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (!unwatched.empty() && ((rescanNext > 0) || (now - lastRescan >= std::chrono::milliseconds(ASSET_RESCAN_INTERVAL_MS))))
+        {
+            for (int i = 0; (i < ASSET_RESCANS_PER_POLL) && (rescanNext < unwatched.size()); i++)
+            {
+                const std::string dir = unwatched[rescanNext++];
+                if (RescanDirectory(dir)) changed = true;
+            }
+
+            if (rescanNext >= unwatched.size())
+            {
+                rescanNext = 0;
+                lastRescan = now;
+            }
+        }
+
+        if (changed) version++;
+        return changed;
+#else
+        return false;
+#endif
+    }
+
+    // Directories inotify would not watch since the last build, they are kept fresh by rescanning
+    unsigned int GetWatchFailures() const
+    {
+        return ready ? watchFailures : 0;
+    }
+
+    unsigned int GetUnwatchedCount() const
+    {
+        return ready ? static_cast<unsigned int>(unwatched.size()) : 0;
+    }
+
+    // Times the event queue overflowed and the tree was crawled again
+    unsigned int GetOverflows() const
+    {
+        return overflows;
+    }
+
+    // Best matches for a query, case insensitive; refines the previous results when the query was only extended
+    const std::vector<AssetMatch>& Search(const char* text)
+    {
+        if (!ready) return results;
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        // Called every frame the search window is open, the scratch string keeps that free of allocations
+        std::string& query = queryScratch;
+        query.assign(text);
+        std::transform(query.begin(), query.end(), query.begin(), Lower);
+
+        if ((query == lastQuery) && (version == lastVersion)) return results;
+
+        const bool refine = !lastQuery.empty() && (version == lastVersion) && (query.compare(0, lastQuery.size(), lastQuery) == 0);
+
+        std::vector<AssetMatch> matches;
+
+        if (refine)
+        {
+            Score(query.c_str(), candidates.data(), candidates.size(), matches);
+        }
+        else
+        {
+            std::vector<unsigned int> all(offsets.size());
+            for (size_t i = 0; i < all.size(); i++) all[i] = static_cast<unsigned int>(i);
+
+            const int threadCount = (all.size() >= ASSET_PARALLEL_SEARCH_MIN) ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+
+            if (threadCount == 1) Score(query.c_str(), all.data(), all.size(), matches);
+            else
+            {
+                std::vector<std::vector<AssetMatch>> partial(threadCount);
+                std::vector<std::thread> threads;
+                const size_t chunk = (all.size() + threadCount - 1)/threadCount;
+
+                for (int t = 0; t < threadCount; t++)
+                {
+                    const size_t begin = std::min(all.size(), t*chunk);
+                    const size_t count = std::min(all.size(), begin + chunk) - begin;
+                    threads.emplace_back([this, &query, &all, &partial, begin, count, t]() { Score(query.c_str(), all.data() + begin, count, partial[t]); });
+                }
+
+                for (std::thread& thread : threads) thread.join();
+                for (std::vector<AssetMatch>& part : partial) matches.insert(matches.end(), part.begin(), part.end());
+            }
+        }
+
+        // Every match stays a candidate for the next keystroke, only the best are shown
+        candidates.resize(matches.size());
+        for (size_t i = 0; i < matches.size(); i++) candidates[i] = matches[i].id;
+
+        const size_t shown = std::min<size_t>(matches.size(), ASSET_MAX_RESULTS);
+        std::partial_sort(matches.begin(), matches.begin() + shown, matches.end(), [](const AssetMatch& a, const AssetMatch& b)
+        {
+            return a.score > b.score;
+        });
+
+        results.assign(matches.begin(), matches.begin() + shown);
+        lastQuery = query;
+        lastVersion = version;
+
+        searchMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return results;
+    }
+
+    // Total number of matches of the last query, not just the ones returned
+    size_t GetMatchCount() const
+    {
+        return candidates.size();
+    }
+};
@@ -0,0 +1,273 @@
+#pragma once
+
+#include "raylib.h"
+
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Which cells of a sheet are byte-identical copies of an earlier cell
+struct FrameDedup
+{
+    int cellCount = 0;
+    int uniqueCount = 0;
+    size_t cellBytes = 0;
+
+    std::vector<int> cellSource;    // Cell -> first identical cell in the sheet
+    std::vector<int> cellUnique;    // Cell -> index among the unique cells
+    std::vector<int> uniqueCells;   // Unique index -> its cell in the sheet
+
+    size_t GetBytesSaved() const
+    {
+        return static_cast<size_t>(cellCount - uniqueCount)*cellBytes;
+    }
+};
+
+// Hash of one frame cell, fed row by row. Four independent 64-bit lanes consume 64 bytes per step
+// (two SSE2 registers each holding two lanes); collisions are ruled out afterwards by comparing bytes.
+class FrameHasher
+{
+private:
+    static const unsigned long long prime1 = 0x9E3779B185EBCA87ULL;
+    static const unsigned long long prime2 = 0xC2B2AE3D27D4EB4FULL;
+    static const unsigned long long prime3 = 0x165667B19E3779F9ULL;
+    static const unsigned long long prime4 = 0x85EBCA77C2B2AE63ULL;
+
+    alignas(16) unsigned long long lanes[4];
+    unsigned long long length;
+
+    static unsigned long long Mix(unsigned long long x)
+    {
+        x ^= x >> 33;
+        x *= prime2;
+        x ^= x >> 29;
+        x *= prime3;
+        x ^= x >> 32;
+        return x;
+    }
+
+#if defined(__SSE2__)
+    // acc += lo32(data ^ key)*hi32(data ^ key) + swap64(data), per 64-bit lane
+    static __m128i Accumulate(__m128i acc, __m128i data, __m128i key)
+    {
+        const __m128i dataKey = _mm_xor_si128(data, key);
+        const __m128i dataKeyHi = _mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1));
+        const __m128i product = _mm_mul_epu32(dataKey, dataKeyHi);
+        const __m128i dataSwap = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+        return _mm_add_epi64(_mm_add_epi64(acc, dataSwap), product);
+    }
+#endif
+
+    static unsigned long long AccumulateScalar(unsigned long long acc, unsigned long long data, unsigned long long swapped, unsigned long long key)
+    {
+        const unsigned long long dataKey = data ^ key;
+        return acc + swapped + (dataKey & 0xFFFFFFFFULL)*(dataKey >> 32);
+    }
+
+    void Block(const unsigned char* block)
+    {
+#if defined(__SSE2__)
+        const __m128i key01 = _mm_set_epi64x(static_cast<long long>(prime2), static_cast<long long>(prime1));
+        const __m128i key23 = _mm_set_epi64x(static_cast<long long>(prime4), static_cast<long long>(prime3));
+
+        __m128i acc01 = _mm_load_si128(reinterpret_cast<const __m128i*>(lanes));
+        __m128i acc23 = _mm_load_si128(reinterpret_cast<const __m128i*>(lanes + 2));
+
+        acc01 = Accumulate(acc01, _mm_loadu_si128(reinterpret_cast<const __m128i*>(block)), key01);
+        acc23 = Accumulate(acc23, _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16)), key23);
+        acc01 = Accumulate(acc01, _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 32)), key01);
+        acc23 = Accumulate(acc23, _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 48)), key23);
+
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc01);
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes + 2), acc23);
+#else
+        const unsigned long long keys[4] = { prime1, prime2, prime3, prime4 };
+
+        for (int half = 0; half < 64; half += 32)
+        {
+            for (int lane = 0; lane < 4; lane++)
+            {
+                unsigned long long data, swapped;
+                memcpy(&data, block + half + lane*8, 8);
+                memcpy(&swapped, block + half + (lane ^ 1)*8, 8);
+                lanes[lane] = AccumulateScalar(lanes[lane], data, swapped, keys[lane]);
+            }
+        }
+#endif
+    }
+
+public:
+    FrameHasher()
+    {
+        lanes[0] = prime1;
+        lanes[1] = prime2;
+        lanes[2] = prime3;
+        lanes[3] = prime4;
+        length = 0;
+    }
+
+    void Update(const unsigned char* data, size_t size)
+    {
+        size_t i = 0;
+        for (; i + 64 <= size; i += 64) Block(data + i);
+
+        // Zero padded tail, the total length is mixed in at the end so padding cannot alias
+        if (i < size)
+        {
+            unsigned char tail[64] = { 0 };
+            memcpy(tail, data + i, size - i);
+            Block(tail);
+        }
+
+        length += size;
+    }
+
+    unsigned long long Digest() const
+    {
+        unsigned long long hash = length*prime1;
+        for (int i = 0; i < 4; i++) hash = Mix(hash ^ Mix(lanes[i]));
+        return hash;
+    }
+};
+
+inline bool IsDedupFormatSupported(int format)
+{
+    return (format > 0) && (format < PIXELFORMAT_COMPRESSED_DXT1);
+}
+
+inline bool CellsEqual(const unsigned char* pixels, int stride, int rowBytes, int frameHeight, int cellA, int cellB, int columns)
+{
+    const unsigned char* a = pixels + (cellA/columns)*frameHeight*stride + (cellA % columns)*rowBytes;
+    const unsigned char* b = pixels + (cellB/columns)*frameHeight*stride + (cellB % columns)*rowBytes;
+
+    for (int y = 0; y < frameHeight; y++)
+    {
+        if (memcmp(a + y*stride, b + y*stride, rowBytes) != 0) return false;
+    }
+
+    return true;
+}
+
+// Hash every cell of a columns x rows sheet and confirm hash matches byte by byte
+inline FrameDedup FindDuplicateFrames(const Image& image, int columns, int rows)
+{
+    FrameDedup dedup;
+    if ((columns <= 0) || (rows <= 0) || (image.data == nullptr) || !IsDedupFormatSupported(image.format)) return dedup;
+
+    const int bytesPerPixel = GetPixelDataSize(1, 1, image.format);
+    const int frameWidth = image.width/columns;
+    const int frameHeight = image.height/rows;
+    const int stride = image.width*bytesPerPixel;
+    const int rowBytes = frameWidth*bytesPerPixel;
+    const unsigned char* pixels = static_cast<const unsigned char*>(image.data);
+
+    dedup.cellCount = columns*rows;
+    dedup.cellBytes = static_cast<size_t>(rowBytes)*frameHeight;
+    dedup.cellSource.resize(dedup.cellCount);
+    dedup.cellUnique.resize(dedup.cellCount);
+
+    // Hash -> unique indices having that hash
+    std::unordered_map<unsigned long long, std::vector<int>> buckets;
+    buckets.reserve(dedup.cellCount);
+
+    for (int cell = 0; cell < dedup.cellCount; cell++)
+    {
+        const unsigned char* origin = pixels + (cell/columns)*frameHeight*stride + (cell % columns)*rowBytes;
+
+        FrameHasher hasher;
+        for (int y = 0; y < frameHeight; y++) hasher.Update(origin + y*stride, rowBytes);
+
+        std::vector<int>& bucket = buckets[hasher.Digest()];
+
+        int unique = -1;
+        for (int candidate : bucket)
+        {
+            if (CellsEqual(pixels, stride, rowBytes, frameHeight, dedup.uniqueCells[candidate], cell, columns))
+            {
+                unique = candidate;
+                break;
+            }
+        }
+
+        if (unique < 0)
+        {
+            unique = static_cast<int>(dedup.uniqueCells.size());
+            dedup.uniqueCells.push_back(cell);
+            bucket.push_back(unique);
+        }
+
+        dedup.cellUnique[cell] = unique;
+        dedup.cellSource[cell] = dedup.uniqueCells[unique];
+    }
+
+    dedup.uniqueCount = static_cast<int>(dedup.uniqueCells.size());
+    return dedup;
+}
+
+// Sheet holding only the unique cells, packed in order of first appearance with the same column count
+inline Image BuildCompactSheet(const Image& image, const FrameDedup& dedup, int columns)
+{
+    const int bytesPerPixel = GetPixelDataSize(1, 1, image.format);
+    const int frameWidth = image.width/columns;
+    const int frameHeight = image.height/(dedup.cellCount/columns);
+    const int compactRows = (dedup.uniqueCount + columns - 1)/columns;
+
+    Image compact = { 0 };
+    compact.width = frameWidth*columns;
+    compact.height = frameHeight*compactRows;
+    compact.mipmaps = 1;
+    compact.format = image.format;
+    compact.data = RL_CALLOC(GetPixelDataSize(compact.width, compact.height, compact.format), 1);
+
+    const int srcStride = image.width*bytesPerPixel;
+    const int dstStride = compact.width*bytesPerPixel;
+    const int rowBytes = frameWidth*bytesPerPixel;
+
+    for (int unique = 0; unique < dedup.uniqueCount; unique++)
+    {
+        const int cell = dedup.uniqueCells[unique];
+        const unsigned char* src = static_cast<const unsigned char*>(image.data) + (cell/columns)*frameHeight*srcStride + (cell % columns)*rowBytes;
+        unsigned char* dst = static_cast<unsigned char*>(compact.data) + (unique/columns)*frameHeight*dstStride + (unique % columns)*rowBytes;
+
+        for (int y = 0; y < frameHeight; y++) memcpy(dst + y*dstStride, src + y*srcStride, rowBytes);
+    }
+
+    return compact;
+}
+
+// Write the compacted sheet plus a text table mapping each original cell to its cell in the compact sheet
+inline bool ExportCompactSheet(const char* sheetPath, int columns, int rows, const char* outputPath)
+{
+    Image image = LoadImage(sheetPath);
+    if (image.data == nullptr) return false;
+
+    const FrameDedup dedup = FindDuplicateFrames(image, columns, rows);
+    if (dedup.cellCount == 0)
+    {
+        UnloadImage(image);
+        return false;
+    }
+
+    Image compact = BuildCompactSheet(image, dedup, columns);
+    bool result = ExportImage(compact, outputPath);
+
+    std::vector<char> table;
+    for (int cell = 0; cell < dedup.cellCount; cell++)
+    {
+        const char* line = TextFormat("%d %d\n", cell, dedup.cellUnique[cell]);
+        table.insert(table.end(), line, line + strlen(line));
+    }
+    table.push_back('\0');
+
+    result = result && SaveFileText(TextFormat("%s.frames.txt", outputPath), table.data());
+
+    TraceLog(LOG_INFO, "DEDUP: %s: %d cells, %d unique, %zu bytes saved", sheetPath, dedup.cellCount, dedup.uniqueCount, dedup.GetBytesSaved());
+
+    UnloadImage(compact);
+    UnloadImage(image);
+    return result;
+}
@@ -0,0 +1,312 @@
+#pragma once
+
+#include "raylib.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define FRAME_IMPORT_MAX_THREADS 8
+
+// A sheet assembled from a folder of per-frame images, frames laid out row by row
+struct FrameImport
+{
+    Image sheet = { 0 };          // RGBA8, data is null when the import failed
+    int columns = 0;
+    int rows = 0;
+    int frameCount = 0;
+    int frameWidth = 0;
+    int frameHeight = 0;
+    int threads = 0;
+
+    double listMs = 0.0;
+    double decodeMs = 0.0;
+    double assembleMs = 0.0;
+    double totalMs = 0.0;
+
+    std::string error;
+};
+
+// Whether path ends in one of a ";" separated list of extensions, ignoring case.
+// NOTE: raylib's IsFileExtension() uses static buffers, this is safe to call from job workers
+inline bool HasFileExtension(const char* path, const char* extensions)
+{
+    const char* dot = strrchr(GetFileName(path), '.');
+    if (dot == nullptr) return false;
+
+    const size_t length = strlen(dot);
+    for (const char* extension = extensions; *extension != '\0'; )
+    {
+        const char* end = strchr(extension, ';');
+        if (end == nullptr) end = extension + strlen(extension);
+
+        bool same = (static_cast<size_t>(end - extension) == length);
+        for (size_t i = 0; same && (i < length); i++) same = (tolower(static_cast<unsigned char>(dot[i])) == tolower(static_cast<unsigned char>(extension[i])));
+        if (same) return true;
+
+        extension = (*end == ';') ? end + 1 : end;
+    }
+
+    return false;
+}
+
+// "frame2" sorts before "frame10": digit runs compare by value, everything else case-insensitively
+inline bool NaturalLess(const char* a, const char* b)
+{
+    const char* pa = a;
+    const char* pb = b;
+
+    while ((*pa != '\0') && (*pb != '\0'))
+    {
+        const bool digitA = (*pa >= '0') && (*pa <= '9');
+        const bool digitB = (*pb >= '0') && (*pb <= '9');
+
+        if (digitA && digitB)
+        {
+            while (*pa == '0') pa++;
+            while (*pb == '0') pb++;
+
+            const char* endA = pa;
+            const char* endB = pb;
+            while ((*endA >= '0') && (*endA <= '9')) endA++;
+            while ((*endB >= '0') && (*endB <= '9')) endB++;
+
+            // Without leading zeros the longer run is the larger number
+            if ((endA - pa) != (endB - pb)) return (endA - pa) < (endB - pb);
+
+            const int order = strncmp(pa, pb, endA - pa);
+            if (order != 0) return order < 0;
+
+            pa = endA;
+            pb = endB;
+            continue;
+        }
+
+        const int ca = ((*pa >= 'A') && (*pa <= 'Z')) ? (*pa - 'A' + 'a') : *pa;
+        const int cb = ((*pb >= 'A') && (*pb <= 'Z')) ? (*pb - 'A' + 'a') : *pb;
+        if (ca != cb) return ca < cb;
+
+        pa++;
+        pb++;
+    }
+
+    if ((*pa == '\0') != (*pb == '\0')) return *pa == '\0';
+
+    // Equal apart from case or zero padding, keep the order stable
+    return strcmp(a, b) < 0;
+}
+
+// Shell-style pattern with * and ?
+inline bool WildcardMatch(const char* pattern, const char* text)
+{
+    const char* star = nullptr;
+    const char* resume = nullptr;
+
+    while (*text != '\0')
+    {
+        if ((*pattern == '?') || (*pattern == *text))
+        {
+            pattern++;
+            text++;
+        }
+        else if (*pattern == '*')
+        {
+            star = pattern++;
+            resume = text;
+        }
+        else if (star != nullptr)
+        {
+            pattern = star + 1;
+            text = ++resume;
+        }
+        else return false;
+    }
+
+    while (*pattern == '*') pattern++;
+    return *pattern == '\0';
+}
+
+inline bool IsFramePattern(const char* path)
+{
+    return (strchr(path, '*') != nullptr) || (strchr(path, '?') != nullptr);
+}
+
+// A folder of frames or a pattern like "walk/frame_*.png", rather than a single sheet
+inline bool IsFrameSource(const char* path)
+{
+    return IsFramePattern(path) || DirectoryExists(path);
+}
+
+// Image files of a folder, or the files matching a pattern in its last path component, naturally sorted
+inline std::vector<std::string> ListFrameFiles(const char* source)
+{
+    std::string directory(source);
+    std::string pattern("*.png");
+
+    if (IsFramePattern(source))
+    {
+        const size_t slash = directory.find_last_of("/\\");
+        pattern = (slash == std::string::npos) ? directory : directory.substr(slash + 1);
+        directory = (slash == std::string::npos) ? std::string(".") : directory.substr(0, slash);
+    }
+
+    std::vector<std::string> files;
+
+    FilePathList list = LoadDirectoryFiles(directory.c_str());
+    for (unsigned int i = 0; i < list.count; i++)
+    {
+        if (!IsPathFile(list.paths[i]) || !HasFileExtension(list.paths[i], ".png")) continue;
+        if (WildcardMatch(pattern.c_str(), GetFileName(list.paths[i]))) files.push_back(list.paths[i]);
+    }
+    UnloadDirectoryFiles(list);
+
+    std::sort(files.begin(), files.end(), [](const std::string& a, const std::string& b) { return NaturalLess(a.c_str(), b.c_str()); });
+    return files;
+}
+
+// Call fn(i) for i in [0, count) on up to threads threads
+inline void ParallelForFrames(int count, int threads, const std::function<void(int)>& fn)
+{
+    // A load running as a job splits into jobs, for idle workers to steal, rather than starting threads of its own
+    JobSystem* pool = JobSystem::GetCurrent();
+    if (pool != nullptr)
+    {
+        pool->ParallelFor(count, threads, fn);
+        return;
+    }
+
+    std::atomic<int> next(0);
+    auto work = [&]()
+    {
+        for (int i = next++; i < count; i = next++) fn(i);
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; i++) workers.emplace_back(work);
+    work();
+    for (std::thread& worker : workers) worker.join();
+}
+
+// Decode every frame in parallel, check they share one size and pack them into a sheet.
+// columns = 0 picks a near square grid
+inline FrameImport ImportFrameFolder(const char* source, int columns = 0)
+{
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point start = Clock::now();
+
+    FrameImport result;
+
+    const std::vector<std::string> files = ListFrameFiles(source);
+    const Clock::time_point listed = Clock::now();
+    result.listMs = std::chrono::duration<double, std::milli>(listed - start).count();
+
+    if (files.empty())
+    {
+        result.error = std::string("No .png frames in ") + source;
+        return result;
+    }
+
+    const int count = static_cast<int>(files.size());
+    result.frameCount = count;
+    result.threads = std::max(1, std::min(std::min(static_cast<int>(std::thread::hardware_concurrency()), FRAME_IMPORT_MAX_THREADS), count));
+
+    std::vector<Image> frames(count);
+    ParallelForFrames(count, result.threads, [&](int i)
+    {
+        frames[i] = LoadImage(files[i].c_str());
+        if ((frames[i].data != nullptr) && (frames[i].format != PIXELFORMAT_UNCOMPRESSED_R8G8B8A8)) ImageFormat(&frames[i], PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    });
+
+    const Clock::time_point decoded = Clock::now();
+    result.decodeMs = std::chrono::duration<double, std::milli>(decoded - listed).count();
+
+    for (int i = 0; (i < count) && result.error.empty(); i++)
+    {
+        if (frames[i].data == nullptr) result.error = "Cannot decode " + files[i];
+        else if ((frames[i].width != frames[0].width) || (frames[i].height != frames[0].height))
+        {
+            char message[64];
+            snprintf(message, sizeof(message), " is %dx%d, expected %dx%d", frames[i].width, frames[i].height, frames[0].width, frames[0].height);
+            result.error = files[i] + message;
+        }
+    }
+
+    if (result.error.empty())
+    {
+        result.frameWidth = frames[0].width;
+        result.frameHeight = frames[0].height;
+        result.columns = (columns > 0) ? std::min(columns, count) : static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+        result.rows = (count + result.columns - 1)/result.columns;
+
+        Image& sheet = result.sheet;
+        sheet.width = result.frameWidth*result.columns;
+        sheet.height = result.frameHeight*result.rows;
+        sheet.mipmaps = 1;
+        sheet.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8;
+        sheet.data = RL_CALLOC(static_cast<size_t>(sheet.width)*sheet.height, 4);
+
+        const size_t rowBytes = static_cast<size_t>(result.frameWidth)*4;
+        const size_t stride = static_cast<size_t>(sheet.width)*4;
+
+        ParallelForFrames(count, result.threads, [&](int i)
+        {
+            unsigned char* dst = static_cast<unsigned char*>(sheet.data) + (i/result.columns)*result.frameHeight*stride + (i % result.columns)*rowBytes;
+            const unsigned char* src = static_cast<const unsigned char*>(frames[i].data);
+
+            for (int y = 0; y < result.frameHeight; y++) memcpy(dst + y*stride, src + y*rowBytes, rowBytes);
+        });
+    }
+
+    for (Image& frame : frames) UnloadImage(frame);
+
+    const Clock::time_point done = Clock::now();
+    result.assembleMs = std::chrono::duration<double, std::milli>(done - decoded).count();
+    result.totalMs = std::chrono::duration<double, std::milli>(done - start).count();
+
+    if (!result.error.empty()) TraceLog(LOG_WARNING, "IMPORT: %s", result.error.c_str());
+    else TraceLog(LOG_INFO, "IMPORT: %s: %d frames of %dx%d in %.1f ms", source, count, result.frameWidth, result.frameHeight, result.totalMs);
+
+    return result;
+}
+
+inline void PrintFrameImportReport(FILE* file, const char* source, const FrameImport& import)
+{
+    fprintf(file, "Import: %s\n", source);
+    fprintf(file, "  frames   %d of %dx%d -> %dx%d sheet (%d columns, %d rows)\n", import.frameCount, import.frameWidth, import.frameHeight,
+            import.sheet.width, import.sheet.height, import.columns, import.rows);
+    fprintf(file, "  list     %8.2f ms\n", import.listMs);
+    fprintf(file, "  decode   %8.2f ms on %d threads (%.3f ms per frame)\n", import.decodeMs, import.threads,
+            (import.frameCount > 0) ? import.decodeMs/import.frameCount : 0.0);
+    fprintf(file, "  assemble %8.2f ms\n", import.assembleMs);
+    fprintf(file, "  total    %8.2f ms\n", import.totalMs);
+}
+
+// Import a folder and write the assembled sheet, for the command line
+inline int ExportFrameFolder(const char* source, const char* outputPath, int columns)
+{
+    FrameImport import = ImportFrameFolder(source, columns);
+    if (import.sheet.data == nullptr)
+    {
+        fprintf(stderr, "%s\n", import.error.c_str());
+        return 1;
+    }
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const bool exported = ExportImage(import.sheet, outputPath);
+    const double exportMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    PrintFrameImportReport(stdout, source, import);
+    printf("  export   %8.2f ms -> %s\n", exportMs, outputPath);
+
+    UnloadImage(import.sheet);
+    return exported ? 0 : 1;
+}
@@ -0,0 +1,365 @@
+#pragma once
+
+#include "raylib.h"
+#include "frame_import.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#define FRAME_MASK_MAX_THREADS 8
+#define FRAME_MASK_HITBOX_BLOCK 4       // Hitbox rectangles are built from blocks of this many pixels
+
+// Where a frame's pixels are in the sheet
+struct FrameMaskSource
+{
+    Rectangle source;
+    bool rotated;       // Stored turned 90 degrees clockwise, like FrameEntry::rotated
+};
+
+// Opacity of one frame, one bit per pixel. Masks are upright: rotated frames are turned back while building
+struct FrameMask
+{
+    int width;
+    int height;
+    int wordsPerRow;    // Rows are padded to whole 64-bit words, padding bits are 0
+    size_t offset;      // First word in the set
+    int opaqueCount;
+    Rectangle bounds;   // Tight box around the opaque pixels, 0 x 0 when there are none
+    int firstHitbox;
+    int hitboxCount;
+};
+
+// 64 bits of a mask row starting at any bit, bits outside the row read as 0
+static inline uint64_t ReadMaskBits(const uint64_t* row, int wordsPerRow, int start)
+{
+    if ((start <= -64) || (start >= wordsPerRow*64)) return 0;
+    if (start < 0) return ReadMaskBits(row, wordsPerRow, 0) << (-start);
+
+    const int word = start >> 6;
+    const int bit = start & 63;
+
+    uint64_t bits = row[word] >> bit;
+    if ((bit != 0) && (word + 1 < wordsPerRow)) bits |= row[word + 1] << (64 - bit);
+    return bits;
+}
+
+static inline uint64_t ReverseBits64(uint64_t v)
+{
+    v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+    v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+    v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    v = ((v >> 8) & 0x00FF00FF00FF00FFULL) | ((v & 0x00FF00FF00FF00FFULL) << 8);
+    v = ((v >> 16) & 0x0000FFFF0000FFFFULL) | ((v & 0x0000FFFF0000FFFFULL) << 16);
+    return (v >> 32) | (v << 32);
+}
+
+// Like ReadMaskBits, on the row mirrored within width
+static inline uint64_t ReadMaskBitsFlipped(const uint64_t* row, int wordsPerRow, int width, int start)
+{
+    return ReverseBits64(ReadMaskBits(row, wordsPerRow, width - start - 64));
+}
+
+static inline int CountTrailingZeros64(uint64_t v)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(v);
+#else
+    int count = 0;
+    while ((v & 1) == 0)
+    {
+        v >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+// Masks and hitboxes of every frame of a sheet, each kind in one contiguous array
+class FrameMaskSet
+{
+private:
+    std::vector<FrameMask> masks;
+    std::vector<uint64_t> words;
+    std::vector<Rectangle> hitboxes;
+
+    double buildMs = 0.0;
+    int threads = 0;
+
+    // Cover the opaque pixels with few rectangles: blocks with any opaque pixel, runs of blocks per
+    // block row, and runs merged downwards while they keep the same span
+    void BuildHitboxes(const FrameMask& mask, std::vector<Rectangle>& out) const
+    {
+        const int block = FRAME_MASK_HITBOX_BLOCK;
+        const int blocksWide = (mask.width + block - 1)/block;
+        const int blocksHigh = (mask.height + block - 1)/block;
+
+        struct OpenBox { int x0, x1, y0; bool kept; };
+        std::vector<OpenBox> open;
+        std::vector<unsigned char> used(blocksWide);
+
+        auto close = [&](const OpenBox& box, int y1)
+        {
+            const float x = static_cast<float>(box.x0*block);
+            const float y = static_cast<float>(box.y0*block);
+            out.push_back(Rectangle{ x, y, std::min<float>(static_cast<float>(box.x1*block), static_cast<float>(mask.width)) - x,
+                                     std::min<float>(static_cast<float>(y1*block), static_cast<float>(mask.height)) - y });
+        };
+
+        for (int by = 0; by <= blocksHigh; by++)
+        {
+            std::fill(used.begin(), used.end(), 0);
+
+            for (int y = by*block; (by < blocksHigh) && (y < std::min(mask.height, (by + 1)*block)); y++)
+            {
+                const uint64_t* row = words.data() + mask.offset + static_cast<size_t>(y)*mask.wordsPerRow;
+                for (int w = 0; w < mask.wordsPerRow; w++)
+                {
+                    for (uint64_t bits = row[w]; bits != 0; bits &= bits - 1) used[(w*64 + CountTrailingZeros64(bits))/block] = 1;
+                }
+            }
+
+            for (OpenBox& box : open) box.kept = false;
+
+            const size_t openCount = open.size();
+            for (int x = 0; x < blocksWide; )
+            {
+                if (!used[x])
+                {
+                    x++;
+                    continue;
+                }
+
+                const int start = x;
+                while ((x < blocksWide) && used[x]) x++;
+
+                bool extended = false;
+                for (size_t i = 0; (i < openCount) && !extended; i++)
+                {
+                    if ((open[i].x0 == start) && (open[i].x1 == x))
+                    {
+                        open[i].kept = true;
+                        extended = true;
+                    }
+                }
+                if (!extended) open.push_back(OpenBox{ start, x, by, true });
+            }
+
+            // Spans that did not continue into this block row end above it
+            size_t kept = 0;
+            for (size_t i = 0; i < open.size(); i++)
+            {
+                if ((i < openCount) && !open[i].kept) close(open[i], by);
+                else open[kept++] = open[i];
+            }
+            open.resize(kept);
+        }
+    }
+
+public:
+    // One mask per source, alpha >= alphaThreshold is opaque. Frames are built in parallel
+    void Build(const Image& image, const std::vector<FrameMaskSource>& sources, unsigned char alphaThreshold = 1)
+    {
+        typedef std::chrono::steady_clock Clock;
+        const Clock::time_point start = Clock::now();
+
+        masks.clear();
+        words.clear();
+        hitboxes.clear();
+
+        size_t wordCount = 0;
+        for (const FrameMaskSource& source : sources)
+        {
+            FrameMask mask = { 0 };
+            mask.width = std::max(0, static_cast<int>(source.rotated ? source.source.height : source.source.width));
+            mask.height = std::max(0, static_cast<int>(source.rotated ? source.source.width : source.source.height));
+            mask.wordsPerRow = (mask.width + 63)/64;
+            mask.offset = wordCount;
+            masks.push_back(mask);
+
+            wordCount += static_cast<size_t>(mask.wordsPerRow)*mask.height;
+        }
+
+        words.assign(wordCount, 0);
+        if ((image.data == nullptr) || masks.empty()) return;
+
+        // Only alpha is read, other formats are converted once
+        Color* converted = (image.format != PIXELFORMAT_UNCOMPRESSED_R8G8B8A8) ? LoadImageColors(image) : nullptr;
+        const Color* pixels = (converted != nullptr) ? converted : static_cast<const Color*>(image.data);
+
+        const int count = static_cast<int>(masks.size());
+        threads = std::max(1, std::min(std::min(static_cast<int>(std::thread::hardware_concurrency()), FRAME_MASK_MAX_THREADS), count));
+
+        std::vector<std::vector<Rectangle>> frameHitboxes(count);
+
+        ParallelForFrames(count, threads, [&](int f)
+        {
+            FrameMask& mask = masks[f];
+            const FrameMaskSource& source = sources[f];
+            const int sourceX = static_cast<int>(source.source.x);
+            const int sourceY = static_cast<int>(source.source.y);
+
+            int minX = mask.width, minY = mask.height, maxX = -1, maxY = -1;
+
+            for (int y = 0; y < mask.height; y++)
+            {
+                uint64_t* row = words.data() + mask.offset + static_cast<size_t>(y)*mask.wordsPerRow;
+                int rowCount = 0;
+
+                for (int x = 0; x < mask.width; x++)
+                {
+                    // Upright (x, y) of a frame stored turned clockwise is at (height - 1 - y, x)
+                    const int sx = sourceX + (source.rotated ? mask.height - 1 - y : x);
+                    const int sy = sourceY + (source.rotated ? x : y);
+                    if ((sx < 0) || (sy < 0) || (sx >= image.width) || (sy >= image.height)) continue;
+
+                    if (pixels[static_cast<size_t>(sy)*image.width + sx].a >= alphaThreshold)
+                    {
+                        row[x >> 6] |= 1ULL << (x & 63);
+                        rowCount++;
+                        minX = std::min(minX, x);
+                        maxX = std::max(maxX, x);
+                    }
+                }
+
+                if (rowCount > 0)
+                {
+                    mask.opaqueCount += rowCount;
+                    minY = std::min(minY, y);
+                    maxY = y;
+                }
+            }
+
+            if (maxX >= 0) mask.bounds = Rectangle{ static_cast<float>(minX), static_cast<float>(minY), static_cast<float>(maxX - minX + 1), static_cast<float>(maxY - minY + 1) };
+            BuildHitboxes(mask, frameHitboxes[f]);
+        });
+
+        if (converted != nullptr) UnloadImageColors(converted);
+
+        for (int f = 0; f < count; f++)
+        {
+            masks[f].firstHitbox = static_cast<int>(hitboxes.size());
+            masks[f].hitboxCount = static_cast<int>(frameHitboxes[f].size());
+            hitboxes.insert(hitboxes.end(), frameHitboxes[f].begin(), frameHitboxes[f].end());
+        }
+
+        buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        TraceLog(LOG_INFO, "MASK: %d frames, %zu bytes of masks, %zu hitboxes in %.2f ms (%d threads)", count, GetByteSize(), hitboxes.size(), buildMs, threads);
+    }
+
+    int GetFrameCount() const
+    {
+        return static_cast<int>(masks.size());
+    }
+
+    const FrameMask& GetMask(int frame) const
+    {
+        return masks[frame];
+    }
+
+    const uint64_t* GetRow(int frame, int y) const
+    {
+        return words.data() + masks[frame].offset + static_cast<size_t>(y)*masks[frame].wordsPerRow;
+    }
+
+    // Upright frame pixel, false outside the frame
+    bool TestPixel(int frame, int x, int y) const
+    {
+        if ((frame < 0) || (frame >= GetFrameCount())) return false;
+
+        const FrameMask& mask = masks[frame];
+        if ((x < 0) || (y < 0) || (x >= mask.width) || (y >= mask.height)) return false;
+
+        return ((GetRow(frame, y)[x >> 6] >> (x & 63)) & 1) != 0;
+    }
+
+    const Rectangle* GetHitboxes(int frame, int* count) const
+    {
+        *count = masks[frame].hitboxCount;
+        return hitboxes.data() + masks[frame].firstHitbox;
+    }
+
+    size_t GetByteSize() const
+    {
+        return words.size()*sizeof(uint64_t) + masks.size()*sizeof(FrameMask) + hitboxes.size()*sizeof(Rectangle);
+    }
+
+    double GetBuildMs() const
+    {
+        return buildMs;
+    }
+
+    int GetThreadCount() const
+    {
+        return threads;
+    }
+};
+
+// Whether frame b, with its top-left at (offsetX, offsetY) in frame a's pixels, covers any pixel frame a covers.
+// A flipped frame is mirrored within its own width. Compares 64 pixels per step
+inline bool FrameMasksOverlap(const FrameMaskSet& setA, int frameA, bool flipA, const FrameMaskSet& setB, int frameB, bool flipB, int offsetX, int offsetY)
+{
+    if ((frameA < 0) || (frameA >= setA.GetFrameCount()) || (frameB < 0) || (frameB >= setB.GetFrameCount())) return false;
+
+    const FrameMask& a = setA.GetMask(frameA);
+    const FrameMask& b = setB.GetMask(frameB);
+    if ((a.opaqueCount == 0) || (b.opaqueCount == 0)) return false;
+
+    // Opaque boxes first, most queries end here
+    const int ax = static_cast<int>(flipA ? a.width - a.bounds.x - a.bounds.width : a.bounds.x);
+    const int bx = offsetX + static_cast<int>(flipB ? b.width - b.bounds.x - b.bounds.width : b.bounds.x);
+    const int x0 = std::max(ax, bx);
+    const int x1 = std::min(ax + static_cast<int>(a.bounds.width), bx + static_cast<int>(b.bounds.width));
+    const int y0 = std::max(static_cast<int>(a.bounds.y), offsetY + static_cast<int>(b.bounds.y));
+    const int y1 = std::min(static_cast<int>(a.bounds.y + a.bounds.height), offsetY + static_cast<int>(b.bounds.y + b.bounds.height));
+    if ((x0 >= x1) || (y0 >= y1)) return false;
+
+    for (int y = y0; y < y1; y++)
+    {
+        const uint64_t* rowA = setA.GetRow(frameA, y);
+        const uint64_t* rowB = setB.GetRow(frameB, y - offsetY);
+
+        for (int x = x0; x < x1; x += 64)
+        {
+            const uint64_t bitsA = flipA ? ReadMaskBitsFlipped(rowA, a.wordsPerRow, a.width, x) : ReadMaskBits(rowA, a.wordsPerRow, x);
+            const uint64_t bitsB = flipB ? ReadMaskBitsFlipped(rowB, b.wordsPerRow, b.width, x - offsetX) : ReadMaskBits(rowB, b.wordsPerRow, x - offsetX);
+            const uint64_t inside = (x1 - x >= 64) ? ~0ULL : ((1ULL << (x1 - x)) - 1);
+
+            if ((bitsA & bitsB & inside) != 0) return true;
+        }
+    }
+
+    return false;
+}
+
+// Per-frame opaque bounds and hitbox rectangles as JSON, in upright frame pixels
+inline bool ExportFrameHitboxes(const FrameMaskSet& masks, const char* fileName)
+{
+    FILE* file = fopen(fileName, "w");
+    if (file == nullptr) return false;
+
+    fprintf(file, "{\n  \"block\": %d,\n  \"frames\": [\n", FRAME_MASK_HITBOX_BLOCK);
+    for (int f = 0; f < masks.GetFrameCount(); f++)
+    {
+        const FrameMask& mask = masks.GetMask(f);
+        fprintf(file, "    { \"frame\": %d, \"w\": %d, \"h\": %d, \"opaque\": %d, \"bounds\": { \"x\": %d, \"y\": %d, \"w\": %d, \"h\": %d }, \"rects\": [",
+                f, mask.width, mask.height, mask.opaqueCount, static_cast<int>(mask.bounds.x), static_cast<int>(mask.bounds.y),
+                static_cast<int>(mask.bounds.width), static_cast<int>(mask.bounds.height));
+
+        int count = 0;
+        const Rectangle* rects = masks.GetHitboxes(f, &count);
+        for (int i = 0; i < count; i++)
+        {
+            fprintf(file, "%s{ \"x\": %d, \"y\": %d, \"w\": %d, \"h\": %d }", (i > 0) ? ", " : " ", static_cast<int>(rects[i].x), static_cast<int>(rects[i].y),
+                    static_cast<int>(rects[i].width), static_cast<int>(rects[i].height));
+        }
+
+        fprintf(file, " ] }%s\n", (f + 1 < masks.GetFrameCount()) ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+
+    return fclose(file) == 0;
+}
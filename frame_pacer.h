@@ -0,0 +1,334 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#define FRAME_PACER_SPIN_MIN_MS 0.25    // Never spin less than this, even when sleeps wake up on time
+#define FRAME_PACER_SPIN_MAX_MS 4.0     // Never spin more than this, even on a coarse system timer
+#define FRAME_JITTER_BINS 48            // Histogram bins between 0 and twice the target interval, plus one for longer frames
+
+// Waits out a fixed frame interval against absolute deadlines. Sleeping alone wakes up late by up to a timer
+// period, spinning alone burns a core, so it sleeps until just before the deadline and spins the rest.
+// The spin window follows how late recent sleeps woke up
+class FramePacer
+{
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    double targetRate;
+    Clock::duration period;
+    Clock::time_point deadline;
+    bool started;
+
+    double oversleepMs;     // Decaying peak of how late sleeps woke up
+    double spinMs;
+    double lastSleepMs;
+    double lastSpinMs;
+    unsigned int resyncs;
+
+public:
+    explicit FramePacer(double targetRate_ = 60.0) : targetRate(0.0), period(Clock::duration::zero()), started(false),
+        oversleepMs(1.0), spinMs(2.0), lastSleepMs(0.0), lastSpinMs(0.0), resyncs(0)
+    {
+        SetTargetRate(targetRate_);
+    }
+
+    // Frames per second, 0 or less runs unpaced
+    void SetTargetRate(double targetRate_)
+    {
+        targetRate = std::max(targetRate_, 0.0);
+        period = (targetRate > 0.0) ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0/targetRate)) : Clock::duration::zero();
+        started = false;
+    }
+
+    // Block until the next frame is due
+    void Wait()
+    {
+        lastSleepMs = 0.0;
+        lastSpinMs = 0.0;
+        if (targetRate <= 0.0) return;
+
+        Clock::time_point now = Clock::now();
+
+        if (!started)
+        {
+            deadline = now;
+            started = true;
+        }
+
+        deadline += period;
+
+        // After a hitch or a load start a new timeline, rather than rushing frames out to catch up
+        if (now > deadline + period)
+        {
+            deadline = now + period;
+            resyncs++;
+        }
+
+        const Clock::time_point wakeAt = deadline - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(spinMs));
+
+        if (now < wakeAt)
+        {
+            std::this_thread::sleep_until(wakeAt);
+
+            const Clock::time_point woke = Clock::now();
+            const double late = std::chrono::duration<double, std::milli>(woke - wakeAt).count();
+            lastSleepMs = std::chrono::duration<double, std::milli>(woke - now).count();
+            now = woke;
+
+            oversleepMs = std::max(late, oversleepMs*0.95);
+            spinMs = std::min(std::max(oversleepMs*1.25, FRAME_PACER_SPIN_MIN_MS), FRAME_PACER_SPIN_MAX_MS);
+        }
+
+        const Clock::time_point spinStart = now;
+        while (now < deadline)
+        {
+            std::this_thread::yield();
+            now = Clock::now();
+        }
+
+        lastSpinMs = std::chrono::duration<double, std::milli>(now - spinStart).count();
+    }
+
+    double GetTargetRate() const
+    {
+        return targetRate;
+    }
+
+    double GetPeriodMs() const
+    {
+        return std::chrono::duration<double, std::milli>(period).count();
+    }
+
+    // Time spent sleeping and spinning in the last Wait()
+    double GetSleepMs() const
+    {
+        return lastSleepMs;
+    }
+
+    double GetSpinMs() const
+    {
+        return lastSpinMs;
+    }
+
+    // Spin window the next Wait() starts with
+    double GetSpinWindowMs() const
+    {
+        return spinMs;
+    }
+
+    // Times the timeline was restarted after falling more than a frame behind
+    unsigned int GetResyncs() const
+    {
+        return resyncs;
+    }
+};
+
+// Frame-to-frame deltas of presented frames, and animation frames shown against their ideal timeline.
+// Fixed size, so recording it every frame does not allocate
+class FrameJitterStats
+{
+private:
+    double periodMs;
+    double binMs;
+    unsigned int bins[FRAME_JITTER_BINS + 1];
+
+    double lastPresentMs;
+    unsigned int deltaCount;
+    double deltaMean;
+    double deltaM2;         // Sum of squared differences from the mean, for the deviation
+    double deltaMin;
+    double deltaMax;
+    unsigned int lateFrames;
+
+    // Animation frame on screen
+    bool hasFrame;
+    unsigned int frameStep;
+    float frameIdealMs;
+    double frameShownMs;
+
+    unsigned int animationFrames;
+    unsigned int droppedFrames;
+    unsigned int duplicatedFrames;
+
+public:
+    explicit FrameJitterStats(double periodMs_ = 1000.0/60.0)
+    {
+        Reset(periodMs_);
+    }
+
+    // Start over for a display running at periodMs_ per frame
+    void Reset(double periodMs_)
+    {
+        periodMs = std::max(periodMs_, 0.1);
+        binMs = 2.0*periodMs/FRAME_JITTER_BINS;
+        std::fill(bins, bins + FRAME_JITTER_BINS + 1, 0u);
+
+        lastPresentMs = -1.0;
+        deltaCount = 0;
+        deltaMean = 0.0;
+        deltaM2 = 0.0;
+        deltaMin = 0.0;
+        deltaMax = 0.0;
+        lateFrames = 0;
+
+        hasFrame = false;
+        frameStep = 0;
+        frameIdealMs = 0.0f;
+        frameShownMs = 0.0;
+
+        animationFrames = 0;
+        droppedFrames = 0;
+        duplicatedFrames = 0;
+    }
+
+    // A frame reached the screen at presentMs
+    void AddPresent(double presentMs)
+    {
+        if (lastPresentMs >= 0.0)
+        {
+            const double delta = presentMs - lastPresentMs;
+            const int bin = static_cast<int>(delta/binMs);
+            bins[std::min(std::max(bin, 0), FRAME_JITTER_BINS)]++;
+
+            deltaCount++;
+            const double diff = delta - deltaMean;
+            deltaMean += diff/deltaCount;
+            deltaM2 += diff*(delta - deltaMean);
+            deltaMin = (deltaCount == 1) ? delta : std::min(deltaMin, delta);
+            deltaMax = std::max(deltaMax, delta);
+            if (delta > 1.5*periodMs) lateFrames++;
+        }
+
+        lastPresentMs = presentMs;
+    }
+
+    // The presented frame showed animation step step_, which should stay on screen for idealMs_.
+    // Steps skipped between presents were dropped; a frame held for more display frames than its
+    // ideal duration rounds to had its extra presents duplicated
+    void AddAnimationFrame(unsigned int step_, float idealMs_, double presentMs)
+    {
+        const unsigned int advanced = step_ - frameStep;
+
+        // First frame, or the animation restarted with a new sheet
+        if (!hasFrame || (advanced > 0x7fffffffu))
+        {
+            hasFrame = true;
+            frameStep = step_;
+            frameIdealMs = idealMs_;
+            frameShownMs = presentMs;
+            return;
+        }
+
+        if (advanced == 0) return;
+
+        animationFrames += advanced;
+        droppedFrames += advanced - 1;
+
+        if (advanced == 1)
+        {
+            const long held = std::lround((presentMs - frameShownMs)/periodMs);
+            const long ideal = std::max(std::lround(frameIdealMs/periodMs), 1L);
+            if (held > ideal) duplicatedFrames += static_cast<unsigned int>(held - ideal);
+        }
+
+        frameStep = step_;
+        frameIdealMs = idealMs_;
+        frameShownMs = presentMs;
+    }
+
+    // Nothing animating, the next frame starts a new run
+    void ClearAnimationFrame()
+    {
+        hasFrame = false;
+    }
+
+    double GetPeriodMs() const
+    {
+        return periodMs;
+    }
+
+    int GetBinCount() const
+    {
+        return FRAME_JITTER_BINS + 1;
+    }
+
+    // The last bin counts every delta of twice the period or more
+    unsigned int GetBin(int index) const
+    {
+        return bins[index];
+    }
+
+    double GetBinMs() const
+    {
+        return binMs;
+    }
+
+    unsigned int GetLargestBin() const
+    {
+        return *std::max_element(bins, bins + FRAME_JITTER_BINS + 1);
+    }
+
+    unsigned int GetDeltaCount() const
+    {
+        return deltaCount;
+    }
+
+    double GetMeanMs() const
+    {
+        return deltaMean;
+    }
+
+    double GetDeviationMs() const
+    {
+        return (deltaCount > 1) ? std::sqrt(deltaM2/(deltaCount - 1)) : 0.0;
+    }
+
+    double GetMinMs() const
+    {
+        return deltaMin;
+    }
+
+    double GetMaxMs() const
+    {
+        return deltaMax;
+    }
+
+    // Upper edge of the bin holding the given fraction of deltas, to the histogram's resolution
+    double GetPercentileMs(double fraction) const
+    {
+        if (deltaCount == 0) return 0.0;
+
+        const double wanted = fraction*deltaCount;
+        double seen = 0.0;
+        for (int i = 0; i < FRAME_JITTER_BINS; i++)
+        {
+            seen += bins[i];
+            if (seen >= wanted) return (i + 1)*binMs;
+        }
+        return deltaMax;
+    }
+
+    // Presents more than half a frame later than the target interval
+    unsigned int GetLateFrames() const
+    {
+        return lateFrames;
+    }
+
+    unsigned int GetAnimationFrames() const
+    {
+        return animationFrames;
+    }
+
+    unsigned int GetDroppedFrames() const
+    {
+        return droppedFrames;
+    }
+
+    unsigned int GetDuplicatedFrames() const
+    {
+        return duplicatedFrames;
+    }
+};
@@ -0,0 +1,644 @@
+#pragma once
+
+#include "raylib.h"
+#include "frame_table.h"
+#include "frame_import.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------------
+// JSON
+//----------------------------------------------------------------------------------
+
+// Slice of the JSON text, escapes are left in place
+struct JsonString
+{
+    const char* data = nullptr;
+    size_t length = 0;
+
+    bool Equals(const char* text) const
+    {
+        return (strlen(text) == length) && (memcmp(data, text, length) == 0);
+    }
+};
+
+// Copy of a string with its escapes decoded, \u ones to UTF-8
+inline std::string UnescapeJsonString(const JsonString& text)
+{
+    std::string out;
+    out.reserve(text.length);
+
+    for (size_t i = 0; i < text.length; i++)
+    {
+        const char c = text.data[i];
+        if ((c != '\\') || (i + 1 >= text.length))
+        {
+            out += c;
+            continue;
+        }
+
+        const char escaped = text.data[++i];
+        switch (escaped)
+        {
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u':
+            {
+                if (i + 4 >= text.length) return out;
+
+                unsigned int code = 0;
+                for (int digit = 0; digit < 4; digit++)
+                {
+                    const char h = text.data[++i];
+                    code = code*16 + static_cast<unsigned int>((h >= '0' && h <= '9') ? h - '0' : (h >= 'a' && h <= 'f') ? h - 'a' + 10 : (h >= 'A' && h <= 'F') ? h - 'A' + 10 : 0);
+                }
+
+                // A surrogate pair spells one code point past the first plane
+                if ((code >= 0xD800) && (code < 0xDC00) && (i + 6 < text.length) && (text.data[i + 1] == '\\') && (text.data[i + 2] == 'u'))
+                {
+                    unsigned int low = 0;
+                    for (int digit = 0; digit < 4; digit++)
+                    {
+                        const char h = text.data[i + 3 + digit];
+                        low = low*16 + static_cast<unsigned int>((h >= '0' && h <= '9') ? h - '0' : (h >= 'a' && h <= 'f') ? h - 'a' + 10 : (h >= 'A' && h <= 'F') ? h - 'A' + 10 : 0);
+                    }
+                    if ((low >= 0xDC00) && (low < 0xE000))
+                    {
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    }
+                }
+
+                if (code < 0x80) out += static_cast<char>(code);
+                else if (code < 0x800)
+                {
+                    out += static_cast<char>(0xC0 | (code >> 6));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                }
+                else if (code < 0x10000)
+                {
+                    out += static_cast<char>(0xE0 | (code >> 12));
+                    out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                }
+                else
+                {
+                    out += static_cast<char>(0xF0 | (code >> 18));
+                    out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                    out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                }
+            } break;
+            default: out += escaped; break;     // \" \\ and \/
+        }
+    }
+
+    return out;
+}
+
+inline bool operator<(const JsonString& a, const JsonString& b)
+{
+    const int order = memcmp(a.data, b.data, std::min(a.length, b.length));
+    return (order != 0) ? (order < 0) : (a.length < b.length);
+}
+
+// Pull parser over a JSON document in memory. It never allocates: strings are slices of the text
+// and numbers are converted in place. Separators are not validated, only what is read is checked,
+// and after an error every call returns false or 0 so loops over members end by themselves
+class JsonCursor
+{
+private:
+    const char* cursor;
+    const char* end;
+    bool failed;
+
+    void Fail()
+    {
+        failed = true;
+        cursor = end;
+    }
+
+    void SkipSpace()
+    {
+        while ((cursor < end) && ((*cursor == ' ') || (*cursor == '\n') || (*cursor == '\r') || (*cursor == '\t'))) cursor++;
+    }
+
+    bool Expect(char c)
+    {
+        SkipSpace();
+        if ((cursor < end) && (*cursor == c))
+        {
+            cursor++;
+            return true;
+        }
+
+        Fail();
+        return false;
+    }
+
+    // After an opening bracket or a value: false and past the bracket at the end of the container
+    bool NextItem(char close)
+    {
+        SkipSpace();
+        if (cursor >= end)
+        {
+            Fail();
+            return false;
+        }
+
+        if (*cursor == close)
+        {
+            cursor++;
+            return false;
+        }
+
+        if (*cursor == ',')
+        {
+            cursor++;
+            SkipSpace();
+        }
+
+        return true;
+    }
+
+public:
+    JsonCursor(const char* text_, size_t length_) : cursor(text_), end(text_ + length_), failed(false)
+    {
+        // Skip a UTF-8 byte order mark, some exporters write one
+        if ((length_ >= 3) && (memcmp(text_, "\xEF\xBB\xBF", 3) == 0)) cursor += 3;
+    }
+
+    bool Failed() const
+    {
+        return failed;
+    }
+
+    // Next significant character without consuming it, 0 at the end
+    char Peek()
+    {
+        SkipSpace();
+        return (cursor < end) ? *cursor : '\0';
+    }
+
+    bool EnterObject()
+    {
+        return Expect('{');
+    }
+
+    bool EnterArray()
+    {
+        return Expect('[');
+    }
+
+    // Next key of the current object, the cursor is left on its value
+    bool NextMember(JsonString* key)
+    {
+        if (!NextItem('}')) return false;
+        return ReadString(key) && Expect(':');
+    }
+
+    // Next value of the current array
+    bool NextElement()
+    {
+        return NextItem(']');
+    }
+
+    bool ReadString(JsonString* value)
+    {
+        if (!Expect('"')) return false;
+
+        const char* start = cursor;
+        while ((cursor < end) && (*cursor != '"')) cursor += (*cursor == '\\') ? 2 : 1;
+
+        if (cursor >= end)
+        {
+            Fail();
+            return false;
+        }
+
+        value->data = start;
+        value->length = static_cast<size_t>(cursor - start);
+        cursor++;
+        return true;
+    }
+
+    double ReadNumber()
+    {
+        SkipSpace();
+
+        bool negative = false;
+        if ((cursor < end) && (*cursor == '-'))
+        {
+            negative = true;
+            cursor++;
+        }
+
+        if ((cursor >= end) || (*cursor < '0') || (*cursor > '9'))
+        {
+            Fail();
+            return 0.0;
+        }
+
+        double value = 0.0;
+        while ((cursor < end) && (*cursor >= '0') && (*cursor <= '9')) value = value*10.0 + (*cursor++ - '0');
+
+        if ((cursor < end) && (*cursor == '.'))
+        {
+            cursor++;
+            double scale = 0.1;
+            while ((cursor < end) && (*cursor >= '0') && (*cursor <= '9'))
+            {
+                value += (*cursor++ - '0')*scale;
+                scale *= 0.1;
+            }
+        }
+
+        if ((cursor < end) && ((*cursor == 'e') || (*cursor == 'E')))
+        {
+            cursor++;
+            bool negativeExponent = false;
+            if ((cursor < end) && ((*cursor == '+') || (*cursor == '-'))) negativeExponent = (*cursor++ == '-');
+
+            int exponent = 0;
+            while ((cursor < end) && (*cursor >= '0') && (*cursor <= '9') && (exponent < 400)) exponent = exponent*10 + (*cursor++ - '0');
+            for (int i = 0; i < exponent; i++) value = negativeExponent ? value/10.0 : value*10.0;
+        }
+
+        return negative ? -value : value;
+    }
+
+    bool ReadBool()
+    {
+        SkipSpace();
+        if ((end - cursor >= 4) && (memcmp(cursor, "true", 4) == 0))
+        {
+            cursor += 4;
+            return true;
+        }
+        if ((end - cursor >= 5) && (memcmp(cursor, "false", 5) == 0))
+        {
+            cursor += 5;
+            return false;
+        }
+
+        Fail();
+        return false;
+    }
+
+    // Step over a value of any kind without looking inside it
+    void Skip()
+    {
+        SkipSpace();
+        if (cursor >= end)
+        {
+            Fail();
+            return;
+        }
+
+        if (*cursor == '"')
+        {
+            JsonString ignored;
+            ReadString(&ignored);
+            return;
+        }
+
+        if ((*cursor != '{') && (*cursor != '['))
+        {
+            // Number, true, false or null
+            while ((cursor < end) && (*cursor != ',') && (*cursor != '}') && (*cursor != ']') &&
+                   (*cursor != ' ') && (*cursor != '\n') && (*cursor != '\r') && (*cursor != '\t')) cursor++;
+            return;
+        }
+
+        int depth = 0;
+        while (cursor < end)
+        {
+            const char c = *cursor++;
+            if ((c == '{') || (c == '[')) depth++;
+            else if ((c == '}') || (c == ']'))
+            {
+                if (--depth == 0) return;
+            }
+            else if (c == '"')
+            {
+                while ((cursor < end) && (*cursor != '"')) cursor += (*cursor == '\\') ? 2 : 1;
+                cursor++;
+            }
+        }
+
+        Fail();
+    }
+};
+
+//----------------------------------------------------------------------------------
+// Sidecars
+//----------------------------------------------------------------------------------
+
+// Frame table read from the JSON that TexturePacker or Aseprite write next to a packed sheet
+struct FrameSidecar
+{
+    std::shared_ptr<FrameTable> frames;     // Null when parsing failed, see error
+    std::string imagePath;                  // meta.image, relative to the sidecar's folder
+    size_t bytes = 0;
+    int skippedAnimations = 0;              // Animations whose frames are not one contiguous run
+
+    double readMs = 0.0;
+    double parseMs = 0.0;
+
+    std::string error;
+};
+
+inline bool IsSidecarFile(const char* path)
+{
+    return HasFileExtension(path, ".json");
+}
+
+// "atlas.png" -> "atlas.json"
+inline std::string GetSidecarPath(const char* imagePath)
+{
+    std::string path(imagePath);
+    const size_t dot = path.find_last_of('.');
+    const size_t slash = path.find_last_of("/\\");
+    if ((dot != std::string::npos) && ((slash == std::string::npos) || (dot > slash))) path.erase(dot);
+    return path + ".json";
+}
+
+inline bool HasFrameSidecar(const char* imagePath)
+{
+    return !IsSidecarFile(imagePath) && FileExists(GetSidecarPath(imagePath).c_str());
+}
+
+// {"x":..,"y":..,"w":..,"h":..}, missing members stay 0
+inline Rectangle ReadSidecarRect(JsonCursor& json)
+{
+    Rectangle rect{ 0, 0, 0, 0 };
+    JsonString key;
+
+    if (!json.EnterObject()) return rect;
+    while (json.NextMember(&key))
+    {
+        if (key.Equals("x")) rect.x = static_cast<float>(json.ReadNumber());
+        else if (key.Equals("y")) rect.y = static_cast<float>(json.ReadNumber());
+        else if (key.Equals("w")) rect.width = static_cast<float>(json.ReadNumber());
+        else if (key.Equals("h")) rect.height = static_cast<float>(json.ReadNumber());
+        else json.Skip();
+    }
+
+    return rect;
+}
+
+// One entry of "frames". TexturePacker gives the unrotated size in "frame", so a rotated frame
+// covers h x w pixels of the sheet
+inline FrameEntry ReadSidecarFrame(JsonCursor& json, JsonString* name)
+{
+    FrameEntry entry;
+    entry.source = Rectangle{ 0, 0, 0, 0 };
+    entry.durationMs = 0.0f;
+
+    JsonString key;
+    if (!json.EnterObject()) return entry;
+    while (json.NextMember(&key))
+    {
+        if (key.Equals("frame")) entry.source = ReadSidecarRect(json);
+        else if (key.Equals("filename") && (name != nullptr)) json.ReadString(name);
+        else if (key.Equals("rotated")) entry.rotated = json.ReadBool();
+        else if (key.Equals("duration")) entry.durationMs = static_cast<float>(json.ReadNumber());
+        else if (key.Equals("spriteSourceSize"))
+        {
+            const Rectangle trim = ReadSidecarRect(json);
+            entry.trimOffset = Vector2{ trim.x, trim.y };
+        }
+        else if (key.Equals("sourceSize"))
+        {
+            const Rectangle size = ReadSidecarRect(json);
+            entry.sourceSize = Vector2{ size.width, size.height };
+        }
+        else json.Skip();
+    }
+
+    if (entry.rotated) std::swap(entry.source.width, entry.source.height);
+    return entry;
+}
+
+inline FrameTagDirection GetSidecarDirection(const JsonString& direction)
+{
+    if (direction.Equals("reverse")) return FrameTagDirection::Reverse;
+    if (direction.Equals("pingpong")) return FrameTagDirection::PingPong;
+    if (direction.Equals("pingpong_reverse")) return FrameTagDirection::PingPongReverse;
+    return FrameTagDirection::Forward;
+}
+
+// Parse sidecar text. Frames may be a hash or an array; tags come from Aseprite's meta.frameTags
+// or from TexturePacker's "animations" lists of frame names
+inline FrameSidecar ParseFrameSidecar(const char* text, size_t length)
+{
+    struct PendingTag
+    {
+        JsonString name;
+        int from;
+        int to;
+        FrameTagDirection direction;
+        size_t firstFrameName;      // Animations name their frames instead, into animationFrames
+        size_t frameNameCount;
+    };
+
+    FrameSidecar result;
+    result.bytes = length;
+    std::shared_ptr<FrameTable> table = std::make_shared<FrameTable>();
+
+    std::vector<JsonString> frameNames;
+    std::vector<JsonString> animationFrames;
+    std::vector<PendingTag> tags;
+    JsonString image;
+
+    JsonCursor json(text, length);
+    JsonString key;
+
+    auto readTags = [&]()
+    {
+        if (!json.EnterArray()) return;
+        while (json.NextElement())
+        {
+            PendingTag tag{ JsonString(), 0, -1, FrameTagDirection::Forward, 0, 0 };
+            JsonString member;
+
+            if (!json.EnterObject()) return;
+            while (json.NextMember(&member))
+            {
+                if (member.Equals("name")) json.ReadString(&tag.name);
+                else if (member.Equals("from")) tag.from = static_cast<int>(json.ReadNumber());
+                else if (member.Equals("to")) tag.to = static_cast<int>(json.ReadNumber());
+                else if (member.Equals("direction"))
+                {
+                    JsonString direction;
+                    json.ReadString(&direction);
+                    tag.direction = GetSidecarDirection(direction);
+                }
+                else json.Skip();
+            }
+            tags.push_back(tag);
+        }
+    };
+
+    auto readAnimations = [&]()
+    {
+        JsonString name;
+        if (!json.EnterObject()) return;
+        while (json.NextMember(&name))
+        {
+            PendingTag tag{ name, 0, -1, FrameTagDirection::Forward, animationFrames.size(), 0 };
+
+            if (!json.EnterArray()) return;
+            while (json.NextElement())
+            {
+                JsonString frame;
+                if (json.ReadString(&frame)) animationFrames.push_back(frame);
+            }
+
+            tag.frameNameCount = animationFrames.size() - tag.firstFrameName;
+            tags.push_back(tag);
+        }
+    };
+
+    if (json.EnterObject())
+    {
+        while (json.NextMember(&key))
+        {
+            if (key.Equals("frames"))
+            {
+                if (json.Peek() == '[')
+                {
+                    json.EnterArray();
+                    while (json.NextElement())
+                    {
+                        JsonString name;
+                        table->AddFrame(ReadSidecarFrame(json, &name));
+                        frameNames.push_back(name);
+                    }
+                }
+                else if (json.EnterObject())
+                {
+                    JsonString name;
+                    while (json.NextMember(&name))
+                    {
+                        table->AddFrame(ReadSidecarFrame(json, nullptr));
+                        frameNames.push_back(name);
+                    }
+                }
+            }
+            else if (key.Equals("animations")) readAnimations();
+            else if (key.Equals("meta") && json.EnterObject())
+            {
+                JsonString member;
+                while (json.NextMember(&member))
+                {
+                    if (member.Equals("image")) json.ReadString(&image);
+                    else if (member.Equals("frameTags")) readTags();
+                    else if (member.Equals("animations")) readAnimations();
+                    else json.Skip();
+                }
+            }
+            else json.Skip();
+        }
+    }
+
+    if (json.Failed())
+    {
+        result.error = "Malformed JSON";
+        return result;
+    }
+    if (table->GetFrameCount() == 0)
+    {
+        result.error = "No frames in JSON";
+        return result;
+    }
+
+    // Frame name -> index, only built when animations refer to frames by name
+    std::vector<std::pair<JsonString, int>> nameIndex;
+    if (!animationFrames.empty())
+    {
+        nameIndex.reserve(frameNames.size());
+        for (size_t i = 0; i < frameNames.size(); i++) nameIndex.push_back(std::make_pair(frameNames[i], static_cast<int>(i)));
+        std::sort(nameIndex.begin(), nameIndex.end(), [](const std::pair<JsonString, int>& a, const std::pair<JsonString, int>& b) { return a.first < b.first; });
+    }
+
+    auto findFrame = [&](const JsonString& name)
+    {
+        auto found = std::lower_bound(nameIndex.begin(), nameIndex.end(), name, [](const std::pair<JsonString, int>& a, const JsonString& b) { return a.first < b; });
+        return ((found != nameIndex.end()) && !(name < found->first)) ? found->second : -1;
+    };
+
+    for (PendingTag& tag : tags)
+    {
+        if (tag.frameNameCount > 0)
+        {
+            // A tag is a range of the table, so only animations over consecutive frames are kept
+            tag.from = findFrame(animationFrames[tag.firstFrameName]);
+            tag.to = tag.from;
+            for (size_t i = 1; (i < tag.frameNameCount) && (tag.to >= 0); i++)
+            {
+                tag.to = (findFrame(animationFrames[tag.firstFrameName + i]) == tag.to + 1) ? tag.to + 1 : -1;
+            }
+
+            if ((tag.from < 0) || (tag.to < 0))
+            {
+                result.skippedAnimations++;
+                continue;
+            }
+        }
+
+        table->AddTag(tag.name.data, tag.name.length, tag.from, tag.to, tag.direction);
+    }
+
+    // Exporters write paths with their slashes escaped, "sheets\/hero.png"
+    result.imagePath = UnescapeJsonString(image);
+    result.frames = table;
+    return result;
+}
+
+// Read and parse a sidecar, meta.image is resolved against the sidecar's folder
+inline FrameSidecar LoadFrameSidecar(const char* fileName)
+{
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point start = Clock::now();
+
+    int size = 0;
+    unsigned char* data = LoadFileData(fileName, &size);
+    const Clock::time_point read = Clock::now();
+
+    if (data == nullptr)
+    {
+        FrameSidecar result;
+        result.error = std::string("Cannot read ") + fileName;
+        return result;
+    }
+
+    FrameSidecar result = ParseFrameSidecar(reinterpret_cast<const char*>(data), static_cast<size_t>(size));
+    UnloadFileData(data);
+
+    result.readMs = std::chrono::duration<double, std::milli>(read - start).count();
+    result.parseMs = std::chrono::duration<double, std::milli>(Clock::now() - read).count();
+
+    const std::string path(fileName);
+    const size_t slash = path.find_last_of("/\\");
+    const bool absolute = !result.imagePath.empty() && ((result.imagePath[0] == '/') || (result.imagePath.find(':') != std::string::npos));
+    if (!result.imagePath.empty() && !absolute && (slash != std::string::npos)) result.imagePath = path.substr(0, slash + 1) + result.imagePath;
+
+    if (!result.error.empty()) TraceLog(LOG_WARNING, "SIDECAR: %s: %s", fileName, result.error.c_str());
+    else
+    {
+        TraceLog(LOG_INFO, "SIDECAR: %s: %d frames, %d tags, %zu bytes parsed in %.2f ms", fileName, result.frames->GetFrameCount(),
+                 result.frames->GetTagCount(), result.bytes, result.parseMs);
+        if (result.skippedAnimations > 0) TraceLog(LOG_WARNING, "SIDECAR: %d animations skipped, their frames are not consecutive", result.skippedAnimations);
+    }
+
+    return result;
+}
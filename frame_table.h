@@ -0,0 +1,120 @@
+#pragma once
+
+#include "raylib.h"
+
+#include <cstring>
+#include <vector>
+
+// How a tagged range of frames plays
+enum class FrameTagDirection
+{
+    Forward = 0,
+    Reverse,
+    PingPong,
+    PingPongReverse
+};
+
+// One frame of an animation and where it lives in the sheet
+struct FrameEntry
+{
+    Rectangle source;                   // Region of the sheet holding the frame, as stored
+    float durationMs;                   // 0 plays at the sprite's frameSpeed
+    Vector2 trimOffset = { 0, 0 };      // Where the trimmed pixels sit inside the untrimmed frame
+    Vector2 sourceSize = { 0, 0 };      // Untrimmed size, 0 when the frame was not trimmed
+    bool rotated = false;               // Stored turned 90 degrees clockwise, source width and height are swapped
+};
+
+// Named animation over an inclusive range of frames
+struct FrameTag
+{
+    int from;
+    int to;
+    FrameTagDirection direction;
+    unsigned int nameOffset;    // Into the table's name arena
+};
+
+// Per-frame data of a sheet that is more than a uniform grid played at one speed.
+// Immutable once built, so the simulation thread can read it while the UI thread holds it too
+class FrameTable
+{
+private:
+    std::vector<FrameEntry> frames;
+    std::vector<FrameTag> tags;
+    std::vector<char> names;
+
+public:
+    void Reserve(int frameCount_, int tagCount_)
+    {
+        frames.reserve(frameCount_);
+        tags.reserve(tagCount_);
+    }
+
+    void AddFrame(const FrameEntry& entry_)
+    {
+        frames.push_back(entry_);
+    }
+
+    // Out of range frames are clamped, a tag without frames is dropped
+    void AddTag(const char* name_, size_t nameLength_, int from_, int to_, FrameTagDirection direction_)
+    {
+        const int last = static_cast<int>(frames.size()) - 1;
+        if ((last < 0) || (from_ > last) || (to_ < from_)) return;
+
+        FrameTag tag;
+        tag.from = (from_ < 0) ? 0 : from_;
+        tag.to = (to_ > last) ? last : to_;
+        tag.direction = direction_;
+        tag.nameOffset = static_cast<unsigned int>(names.size());
+        tags.push_back(tag);
+
+        names.insert(names.end(), name_, name_ + nameLength_);
+        names.push_back('\0');
+    }
+
+    int GetFrameCount() const
+    {
+        return static_cast<int>(frames.size());
+    }
+
+    const FrameEntry& GetFrame(int index) const
+    {
+        return frames[index];
+    }
+
+    int GetTagCount() const
+    {
+        return static_cast<int>(tags.size());
+    }
+
+    size_t GetByteSize() const
+    {
+        return frames.capacity()*sizeof(FrameEntry) + tags.capacity()*sizeof(FrameTag) + names.capacity();
+    }
+
+    const FrameTag& GetTag(int index) const
+    {
+        return tags[index];
+    }
+
+    const char* GetTagName(int index) const
+    {
+        return names.data() + tags[index].nameOffset;
+    }
+
+    // Frames a tag covers, the whole table for an index that is not a tag
+    void GetRange(int tag, int* from, int* to, FrameTagDirection* direction) const
+    {
+        if ((tag >= 0) && (tag < GetTagCount()))
+        {
+            *from = tags[tag].from;
+            *to = tags[tag].to;
+            *direction = tags[tag].direction;
+        }
+        else
+        {
+            *from = 0;
+            *to = GetFrameCount() - 1;
+            *direction = FrameTagDirection::Forward;
+        }
+    }
+};
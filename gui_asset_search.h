@@ -0,0 +1,130 @@
+#pragma once
+
+#include "asset_index.h"
+#include "raygui/src/raygui.h"
+
+#include <cstring>
+#include <vector>
+
+// Find Asset window: indexes a whole directory tree and fuzzy filters it as you type
+struct GuiAssetSearchState
+{
+    // Window management variables
+    bool windowActive;
+    Rectangle windowBounds;
+
+    // UI variables
+    bool rootEditMode;
+    char rootText[1024];
+    bool queryEditMode;
+    char queryText[256];
+    char queryTextCopy[256];
+
+    int resultsScrollIndex;
+    int resultsActive;
+    int resultsFocused;
+
+    bool OpenPressed;
+    char selectedPath[1024];
+
+    // Custom state variables
+    AssetIndex index;
+    std::vector<const char*> resultNames;
+};
+
+inline void InitGuiAssetSearch(GuiAssetSearchState* state, const char* rootPath)
+{
+    state->windowActive = false;
+    state->windowBounds = Rectangle{ static_cast<float>(GetScreenWidth()/2 - 520/2), static_cast<float>(GetScreenHeight()/2 - 420/2), 520, 420 };
+
+    state->rootEditMode = false;
+    strncpy(state->rootText, rootPath, sizeof(state->rootText) - 1);
+    state->rootText[sizeof(state->rootText) - 1] = '\0';
+
+    state->queryEditMode = false;
+    state->queryText[0] = '\0';
+    state->queryTextCopy[0] = '\0';
+
+    state->resultsScrollIndex = 0;
+    state->resultsActive = -1;
+    state->resultsFocused = -1;
+
+    state->OpenPressed = false;
+    state->selectedPath[0] = '\0';
+}
+
+// Keep the index in step with the file system, every frame whether the window is open or not
+inline void UpdateGuiAssetSearch(GuiAssetSearchState* state)
+{
+    state->index.Poll();
+}
+
+// Update and draw the Find Asset window
+inline void GuiAssetSearch(GuiAssetSearchState* state)
+{
+    if (!state->windowActive) return;
+
+    AssetIndex& index = state->index;
+    const Rectangle bounds = state->windowBounds;
+
+    // Index lazily on first open
+    if (!index.IsReady() && !index.IsBuilding()) index.Build(state->rootText);
+
+    state->windowActive = !GuiWindowBox(bounds, "#42# Find Asset");
+
+    // Root directory + reindex
+    if (GuiTextBox(Rectangle{ bounds.x + 8, bounds.y + 36, bounds.width - 104, 24 }, state->rootText, sizeof(state->rootText), state->rootEditMode))
+    {
+        state->rootEditMode = !state->rootEditMode;
+    }
+
+    if (GuiButton(Rectangle{ bounds.x + bounds.width - 88, bounds.y + 36, 80, 24 }, index.IsBuilding() ? "Indexing..." : "Reindex"))
+    {
+        index.Build(state->rootText);
+    }
+
+    // Query, filtered as it is typed
+    GuiLabel(Rectangle{ bounds.x + 8, bounds.y + 68, 48, 24 }, "Search:");
+    if (GuiTextBox(Rectangle{ bounds.x + 56, bounds.y + 68, bounds.width - 64, 24 }, state->queryText, sizeof(state->queryText), state->queryEditMode))
+    {
+        state->queryEditMode = !state->queryEditMode;
+    }
+
+    if (strcmp(state->queryText, state->queryTextCopy) != 0)
+    {
+        strcpy(state->queryTextCopy, state->queryText);
+        state->resultsActive = -1;
+        state->resultsScrollIndex = 0;
+    }
+
+    const std::vector<AssetMatch>& results = index.Search(state->queryText);
+
+    state->resultNames.resize(results.size());
+    for (size_t i = 0; i < results.size(); i++) state->resultNames[i] = index.GetPath(results[i].id);
+
+    int prevTextAlignment = GuiGetStyle(LISTVIEW, TEXT_ALIGNMENT);
+    GuiSetStyle(LISTVIEW, TEXT_ALIGNMENT, TEXT_ALIGN_LEFT);
+    GuiListViewEx(Rectangle{ bounds.x + 8, bounds.y + 100, bounds.width - 16, bounds.height - 100 - 68 },
+                  state->resultNames.data(), static_cast<int>(results.size()), &state->resultsScrollIndex, &state->resultsActive, &state->resultsFocused);
+    GuiSetStyle(LISTVIEW, TEXT_ALIGNMENT, prevTextAlignment);
+
+    // Status + bottom controls
+    const char* status = index.IsBuilding() ? "Indexing..." :
+        (index.GetUnwatchedCount() > 0) ?
+        TextFormat("%u images indexed in %.0f ms | %u matches in %.2f ms | %u dirs unwatched, rescanned", index.GetCount(), index.GetBuildMs(), static_cast<unsigned int>(index.GetMatchCount()), index.GetSearchMs(), index.GetUnwatchedCount()) :
+        TextFormat("%u images indexed in %.0f ms | %u matches in %.2f ms", index.GetCount(), index.GetBuildMs(), static_cast<unsigned int>(index.GetMatchCount()), index.GetSearchMs());
+    GuiLabel(Rectangle{ bounds.x + 8, bounds.y + bounds.height - 60, bounds.width - 16, 20 }, status);
+
+    const bool hasSelection = (state->resultsActive >= 0) && (state->resultsActive < static_cast<int>(results.size()));
+
+    if (GuiButton(Rectangle{ bounds.x + bounds.width - 208, bounds.y + bounds.height - 36, 96, 24 }, "Open") && hasSelection)
+    {
+        strncpy(state->selectedPath, index.GetFullPath(results[state->resultsActive].id).c_str(), sizeof(state->selectedPath) - 1);
+        state->selectedPath[sizeof(state->selectedPath) - 1] = '\0';
+
+        state->OpenPressed = true;
+        state->windowActive = false;
+    }
+
+    if (GuiButton(Rectangle{ bounds.x + bounds.width - 104, bounds.y + bounds.height - 36, 96, 24 }, "Cancel")) state->windowActive = false;
+}
@@ -42,6 +42,12 @@
 #ifndef GUI_WINDOW_FILE_DIALOG_H
 #define GUI_WINDOW_FILE_DIALOG_H
 
+#if defined(__cplusplus)
+class JobSystem;
+#else
+typedef struct JobSystem JobSystem;
+#endif
+
 // Gui file dialog context data
 typedef struct {
 
@@ -77,6 +83,12 @@ typedef struct {
 
     bool saveFileMode;
 
+    // Directories are listed by a job when set, otherwise right away
+    JobSystem *jobs;
+    unsigned int listingRequested;      // A listing finished for an older request is dropped
+    unsigned int listingLoaded;
+    unsigned int listingShown;          // Changes with every listing put in dirFiles, whichever way it was read
+
 } GuiWindowFileDialogState;
 
 #ifdef __cplusplus
@@ -118,14 +130,21 @@ void GuiWindowFileDialog(GuiWindowFileDialogState *state);
 #if defined(GUI_WINDOW_FILE_DIALOG_IMPLEMENTATION)
 
 #include "raygui/src/raygui.h"
+#include "job_system.h"
+#include "memory_budget.h"
 
 #include <string.h>     // Required for: strcpy()
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 //----------------------------------------------------------------------------------
 // Defines and Macros
 //----------------------------------------------------------------------------------
 #define MAX_DIRECTORY_FILES    2048
 #define MAX_ICON_PATH_LENGTH    512
+#define DIRECTORY_PATH_BUFFER_SIZE  4096    // raylib's MAX_FILEPATH_LENGTH, every path slot of a listing gets one
 #ifdef _WIN32
 #define PATH_SEPERATOR "\\"
 #else
@@ -153,6 +172,7 @@ typedef char *FileInfo;             // Files are just a path string
 // Global Variables Definition
 //----------------------------------------------------------------------------------
 FileInfo *dirFilesIcon = NULL;      // Path string + icon (for fancy drawing)
+static MemoryCharge fileDialogMemory(MemoryPool::FileDialog);
 
 //----------------------------------------------------------------------------------
 // Internal Module Functions Definition
@@ -160,6 +180,12 @@ FileInfo *dirFilesIcon = NULL;      // Path string + icon (for fancy drawing)
 // Read files in new path
 static void ReloadDirectoryFiles(GuiWindowFileDialogState *state);
 
+// Show a listing: icons and names for the list view
+static void SetDirectoryFiles(GuiWindowFileDialogState *state, FilePathList files, const char *isFile);
+
+// Report the icon buffers and the listing's path buffers to the memory ledger
+static void UpdateFileDialogMemory(const GuiWindowFileDialogState *state);
+
 #if defined(USE_CUSTOM_LISTVIEW_FILEINFO)
 // List View control for files info with extended parameters
 static int GuiListViewFiles(Rectangle bounds, FileInfo *files, int count, int *focus, int *scrollIndex, int active);
@@ -264,10 +290,11 @@ void GuiWindowFileDialog(GuiWindowFileDialogState *state)
         {
             dirFilesIcon = (FileInfo *)RL_CALLOC(MAX_DIRECTORY_FILES, sizeof(FileInfo));    // Max files to read
             for (int i = 0; i < MAX_DIRECTORY_FILES; i++) dirFilesIcon[i] = (char *)RL_CALLOC(MAX_ICON_PATH_LENGTH, 1);    // Max file name length
+            UpdateFileDialogMemory(state);
         }
 
-        // Load current directory files
-        if (state->dirFiles.paths == NULL) ReloadDirectoryFiles(state);
+        // Load current directory files, unless a listing is already on its way
+        if ((state->dirFiles.paths == NULL) && (state->listingLoaded == state->listingRequested)) ReloadDirectoryFiles(state);
         //----------------------------------------------------------------------------------------
 
         // Draw window and controls
@@ -321,6 +348,11 @@ void GuiWindowFileDialog(GuiWindowFileDialogState *state)
         GuiSetStyle(LISTVIEW, TEXT_ALIGNMENT, prevTextAlignment);
         GuiSetStyle(LISTVIEW, LIST_ITEMS_HEIGHT, prevElementsHeight);
 
+        if (state->listingLoaded != state->listingRequested)
+        {
+            GuiLabel((Rectangle){ state->windowBounds.x + 16, state->windowBounds.y + 48 + 24, state->windowBounds.width - 32, 24 }, "Reading directory...");
+        }
+
         // Check if a path has been selected, if it is a directory, move to that directory (and reload paths)
         if ((state->filesListActive >= 0) && (state->filesListActive != state->prevFilesListActive))
             //&& (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) || IsKeyPressed(KEY_ENTER) || IsKeyPressed(KEY_DPAD_A)))
@@ -404,6 +436,7 @@ void GuiWindowFileDialog(GuiWindowFileDialogState *state)
             state->dirFiles.count = 0;
             state->dirFiles.capacity = 0;
             state->dirFiles.paths = NULL;
+            UpdateFileDialogMemory(state);
         }
     }
 }
@@ -423,21 +456,81 @@ static inline int FileCompare(const char *d1, const char *d2, const char *dir)
     return strcmp(d1, d2);
 }
 
+// A directory read by a job, handed over to the dialog on the main thread
+struct DirectoryListing
+{
+    FilePathList files;
+    std::vector<char> isFile;       // A stat per path, most of the time a slow listing takes
+
+    DirectoryListing() : files{ 0 } {}
+    ~DirectoryListing() { if (files.paths != NULL) UnloadDirectoryFiles(files); }
+};
+
+// NOTE: raylib scans directories into a static path buffer, so listings must not overlap
+static std::mutex directoryScanMutex;
+static CancelToken directoryListingCancel = CancelToken::None();
+
 // Read files in new path
 static void ReloadDirectoryFiles(GuiWindowFileDialogState *state)
 {
     UnloadDirectoryFiles(state->dirFiles);
-
-    state->dirFiles = LoadDirectoryFilesEx(state->dirPathText, (state->filterExt[0] == '\0')? NULL : state->filterExt, false);
+    state->dirFiles = (FilePathList){ 0 };
     state->itemFocused = 0;
+    UpdateFileDialogMemory(state);
 
     // Reset dirFilesIcon memory
     for (int i = 0; i < MAX_DIRECTORY_FILES; i++) memset(dirFilesIcon[i], 0, MAX_ICON_PATH_LENGTH);
 
+    if (state->jobs == NULL)
+    {
+        FilePathList files = LoadDirectoryFilesEx(state->dirPathText, (state->filterExt[0] == '\0')? NULL : state->filterExt, false);
+        SetDirectoryFiles(state, files, NULL);
+        return;
+    }
+
+    // Only the newest listing is wanted
+    directoryListingCancel.Cancel();
+    directoryListingCancel = CancelToken();
+
+    const unsigned int version = ++state->listingRequested;
+    const std::string path(state->dirPathText);
+    const std::string filter(state->filterExt);
+    JobSystem *jobs = state->jobs;
+
+    jobs->Submit(JobPriority::Interactive, [state, version, path, filter, jobs]()
+    {
+        std::shared_ptr<DirectoryListing> listing = std::make_shared<DirectoryListing>();
+        {
+            std::lock_guard<std::mutex> lock(directoryScanMutex);
+            listing->files = LoadDirectoryFilesEx(path.c_str(), filter.empty()? NULL : filter.c_str(), false);
+        }
+
+        listing->isFile.resize(listing->files.count);
+        for (unsigned int i = 0; i < listing->files.count; i++) listing->isFile[i] = IsPathFile(listing->files.paths[i]);
+
+        jobs->PostMain([state, version, listing]()
+        {
+            // Reloaded again, or closed, while this one was being read
+            if (version != state->listingRequested) return;
+            state->listingLoaded = version;
+            if (!state->windowActive) return;
+
+            SetDirectoryFiles(state, listing->files, listing->isFile.data());
+            listing->files = (FilePathList){ 0 };
+        });
+    }, directoryListingCancel);
+}
+
+static void SetDirectoryFiles(GuiWindowFileDialogState *state, FilePathList files, const char *isFile)
+{
+    state->dirFiles = files;
+    state->listingShown++;
+    UpdateFileDialogMemory(state);
+
     // Copy paths as icon + fileNames into dirFilesIcon
-    for (int i = 0; i < state->dirFiles.count; i++)
+    for (unsigned int i = 0; (i < state->dirFiles.count) && (i < MAX_DIRECTORY_FILES); i++)
     {
-        if (IsPathFile(state->dirFiles.paths[i]))
+        if ((isFile != NULL)? isFile[i] : IsPathFile(state->dirFiles.paths[i]))
         {
             // Path is a file, a file icon for convenience (for some recognized extensions)
             if (IsFileExtension(state->dirFiles.paths[i], ".png;.bmp;.tga;.gif;.jpg;.jpeg;.psd;.hdr;.qoi;.dds;.pkm;.ktx;.pvr;.astc"))
@@ -466,6 +559,15 @@ static void ReloadDirectoryFiles(GuiWindowFileDialogState *state)
     }
 }
 
+static void UpdateFileDialogMemory(const GuiWindowFileDialogState *state)
+{
+    size_t bytes = 0;
+    if (dirFilesIcon != NULL) bytes += MAX_DIRECTORY_FILES*(sizeof(FileInfo) + MAX_ICON_PATH_LENGTH);
+    if (state->dirFiles.paths != NULL) bytes += state->dirFiles.capacity*(sizeof(char *) + DIRECTORY_PATH_BUFFER_SIZE);
+
+    fileDialogMemory.Set(bytes, 0);
+}
+
 #if defined(USE_CUSTOM_LISTVIEW_FILEINFO)
 // List View control for files info with extended parameters
 static int GuiListViewFiles(Rectangle bounds, FileInfo *files, int count, int *focus, int *scrollIndex, int *active)
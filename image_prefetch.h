@@ -0,0 +1,260 @@
+#pragma once
+
+#include "raylib.h"
+#include "job_system.h"
+#include "memory_budget.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define PREFETCH_MAX_IMAGES 8
+#define PREFETCH_MAX_BYTES (256*1024*1024)
+
+// Decodes images the user is likely to open next as background jobs and keeps them in a small LRU cache
+class ImagePrefetcher
+{
+private:
+    enum class EntryState
+    {
+        Queued,
+        Decoding,
+        Ready
+    };
+
+    struct Entry
+    {
+        std::string key;
+        Image image;
+        EntryState state;
+        unsigned long long lastUse;
+    };
+
+    JobSystem& jobs;
+    CancelToken wanted;              // Replaced with the wanted set, queued decodes of the old one are skipped
+    JobCounter outstanding;          // Decode jobs not yet run or skipped, they point back at the cache
+
+    std::vector<Entry> cache;
+    unsigned long long useClock;
+
+    std::atomic<unsigned int> hits;
+    std::atomic<unsigned int> misses;
+
+    std::mutex mutex;
+    std::condition_variable decoded; // Take() waits for in-flight decodes
+
+    MemoryCharge memoryCharge;       // Decoded images still in the cache
+
+    // Paths from the file dialog and the ones we build ourselves may use different separators
+    static std::string MakeKey(const char* path)
+    {
+        std::string key(path);
+        std::replace(key.begin(), key.end(), '\\', '/');
+        return key;
+    }
+
+    Entry* Find(const std::string& key)
+    {
+        for (Entry& entry : cache)
+        {
+            if (entry.key == key) return &entry;
+        }
+
+        return nullptr;
+    }
+
+    static size_t ImageBytes(const Image& image)
+    {
+        return (image.data != nullptr) ? static_cast<size_t>(GetPixelDataSize(image.width, image.height, image.format)) : 0;
+    }
+
+    void UpdateMemoryCharge()
+    {
+        size_t bytes = 0;
+        for (const Entry& entry : cache)
+        {
+            if (entry.state == EntryState::Ready) bytes += ImageBytes(entry.image);
+        }
+        memoryCharge.Set(bytes, 0);
+    }
+
+    // Drop least recently wanted decoded images until the cache is within its limits
+    void Evict()
+    {
+        for (;;)
+        {
+            size_t count = 0;
+            size_t bytes = 0;
+            Entry* oldest = nullptr;
+
+            for (Entry& entry : cache)
+            {
+                if (entry.state != EntryState::Ready) continue;
+
+                count++;
+                bytes += ImageBytes(entry.image);
+                if ((oldest == nullptr) || (entry.lastUse < oldest->lastUse)) oldest = &entry;
+            }
+
+            if ((oldest == nullptr) || ((count <= PREFETCH_MAX_IMAGES) && (bytes <= PREFETCH_MAX_BYTES))) return;
+
+            UnloadImage(oldest->image);
+            cache.erase(cache.begin() + (oldest - cache.data()));
+        }
+    }
+
+    void Decode(const std::string& key, const CancelToken& token)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        // No longer wanted, or taken by a load before it started
+        Entry* entry = Find(key);
+        if (token.IsCancelled() || (entry == nullptr) || (entry->state != EntryState::Queued)) return;
+        entry->state = EntryState::Decoding;
+
+        lock.unlock();
+        Image image = LoadImage(key.c_str());
+        lock.lock();
+
+        entry = Find(key);
+        entry->image = image;
+        entry->state = EntryState::Ready;
+
+        Evict();
+        UpdateMemoryCharge();
+        decoded.notify_all();
+    }
+
+public:
+    explicit ImagePrefetcher(JobSystem& jobs_) : jobs(jobs_), useClock(0), hits(0), misses(0), memoryCharge(MemoryPool::Prefetch)
+    {
+    }
+
+    ~ImagePrefetcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            wanted.Cancel();
+        }
+
+        outstanding.Wait();
+
+        for (Entry& entry : cache)
+        {
+            if (entry.state == EntryState::Ready) UnloadImage(entry.image);
+        }
+    }
+
+    ImagePrefetcher(const ImagePrefetcher&) = delete;
+    ImagePrefetcher& operator=(const ImagePrefetcher&) = delete;
+
+    // Replace the wanted set, most wanted first; queued paths that are no longer wanted are cancelled
+    void Request(const char* const* paths, int count)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        wanted.Cancel();
+        wanted = CancelToken();
+        cache.erase(std::remove_if(cache.begin(), cache.end(), [](const Entry& entry) { return entry.state == EntryState::Queued; }), cache.end());
+
+        for (int i = 0; i < count; i++)
+        {
+            const std::string key = MakeKey(paths[i]);
+
+            // Earlier paths are more wanted, keep them longest
+            Entry* entry = Find(key);
+            if (entry != nullptr)
+            {
+                entry->lastUse = useClock + count - i;
+                continue;
+            }
+
+            cache.push_back(Entry{key, Image{}, EntryState::Queued, useClock + count - i});
+
+            const CancelToken token = wanted;
+            jobs.Submit(JobPriority::Background, [this, key, token]() { Decode(key, token); }, token, &outstanding);
+        }
+
+        useClock += count;
+    }
+
+    void Cancel()
+    {
+        Request(nullptr, 0);
+    }
+
+    // Drop decoded images, least recently wanted first, until at least bytes are freed or none are left;
+    // returns what was freed. Called when a load needs the memory the cache holds
+    size_t Release(size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        size_t freed = 0;
+        while (freed < bytes)
+        {
+            Entry* oldest = nullptr;
+            for (Entry& entry : cache)
+            {
+                if ((entry.state == EntryState::Ready) && ((oldest == nullptr) || (entry.lastUse < oldest->lastUse))) oldest = &entry;
+            }
+            if (oldest == nullptr) break;
+
+            freed += ImageBytes(oldest->image);
+            UnloadImage(oldest->image);
+            cache.erase(cache.begin() + (oldest - cache.data()));
+        }
+
+        UpdateMemoryCharge();
+        return freed;
+    }
+
+    // Hand over a decoded image, waiting if it is still being decoded; returns false if it was never requested.
+    // Safe from a job worker: an image whose decode has not started is given up, never waited for
+    bool Take(const char* path, Image& image)
+    {
+        const std::string key = MakeKey(path);
+        std::unique_lock<std::mutex> lock(mutex);
+
+        Entry* entry = Find(key);
+        while ((entry != nullptr) && (entry->state == EntryState::Decoding))
+        {
+            decoded.wait(lock);
+            entry = Find(key);
+        }
+
+        if ((entry == nullptr) || (entry->state == EntryState::Queued))
+        {
+            // Not started yet, the caller decodes it now so do not do it twice
+            if (entry != nullptr) cache.erase(cache.begin() + (entry - cache.data()));
+            misses++;
+            return false;
+        }
+
+        image = entry->image;
+        cache.erase(cache.begin() + (entry - cache.data()));
+        UpdateMemoryCharge();
+
+        // A failed decode counts as a miss so the caller reports the error through its normal path
+        if (image.data == nullptr)
+        {
+            misses++;
+            return false;
+        }
+
+        hits++;
+        return true;
+    }
+
+    unsigned int GetHits() const
+    {
+        return hits.load(std::memory_order_relaxed);
+    }
+
+    unsigned int GetMisses() const
+    {
+        return misses.load(std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,545 @@
+#pragma once
+
+#include "simulation.h"
+#include "sprite.h"
+#include "sheet_source.h"
+#include "memory_budget.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define REPLAY_MAGIC 0x4C525653u  // "SVRL"
+#define REPLAY_VERSION 2           // 2 logs the load options with every LoadSheet, 1 is still read
+#define REPLAY_MAX_PATH 512
+
+// Raw input sampled once per frame, only logged when it changes
+struct InputState
+{
+    short mouseX;
+    short mouseY;
+    unsigned char buttons;  // Bit 0 left, bit 1 right, bit 2 middle
+    float wheel;
+};
+
+inline bool operator==(const InputState& a, const InputState& b)
+{
+    return a.mouseX == b.mouseX && a.mouseY == b.mouseY && a.buttons == b.buttons && a.wheel == b.wheel;
+}
+
+inline InputState CaptureInputState()
+{
+    const Vector2 mouse = GetMousePosition();
+
+    InputState input {};
+    input.mouseX = static_cast<short>(mouse.x);
+    input.mouseY = static_cast<short>(mouse.y);
+    input.buttons = (IsMouseButtonDown(MOUSE_BUTTON_LEFT) ? 1 : 0) | (IsMouseButtonDown(MOUSE_BUTTON_RIGHT) ? 2 : 0) | (IsMouseButtonDown(MOUSE_BUTTON_MIDDLE) ? 4 : 0);
+    input.wheel = GetMouseWheelMove();
+    return input;
+}
+
+enum class ReplayEventType : unsigned char
+{
+    Input = 1,
+    Params,     // Playback settings changed
+    Row,        // Row picked in the UI
+    LoadSheet,  // Sheet loaded with a column/row grid and load options
+    ClearSheet, // Sheet unloaded by a grid change
+    End         // Last recorded frame
+};
+
+// Settings that change what a loaded sheet becomes and what it costs
+struct ReplayLoadOptions
+{
+    bool compactDuplicates;
+    bool premultiplyAlpha;
+    unsigned char packMode;     // PixelPackMode
+    int packTolerance;
+};
+
+struct ReplayEvent
+{
+    ReplayEventType type;
+    unsigned int frame;
+    unsigned int timeUs;    // Microseconds since recording started
+
+    InputState input;
+    SpriteParams params;
+    int selectedRow;
+    int frameColumns;
+    int frameRows;
+    ReplayLoadOptions loadOptions;
+    char path[REPLAY_MAX_PATH];
+};
+
+// Records input and UI state changes into a compact little-endian binary log
+class InputRecorder
+{
+private:
+    std::vector<unsigned char> buffer;
+    std::chrono::steady_clock::time_point start;
+    InputState lastInput;
+    bool hasInput;
+    std::string workingDirectory;
+
+    void Put(const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        buffer.insert(buffer.end(), bytes, bytes + size);
+    }
+
+    void PutU8(unsigned char value) { Put(&value, 1); }
+    void PutU16(unsigned short value) { PutU8(value & 0xFF); PutU8(value >> 8); }
+    void PutU32(unsigned int value) { PutU16(value & 0xFFFF); PutU16(value >> 16); }
+    void PutI32(int value) { PutU32(static_cast<unsigned int>(value)); }
+
+    void PutF32(float value)
+    {
+        unsigned int bits;
+        memcpy(&bits, &value, sizeof(bits));
+        PutU32(bits);
+    }
+
+    void BeginEvent(ReplayEventType type, unsigned int frame)
+    {
+        const unsigned int timeUs = static_cast<unsigned int>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+
+        PutU8(static_cast<unsigned char>(type));
+        PutU32(frame);
+        PutU32(timeUs);
+    }
+
+public:
+    explicit InputRecorder(int tickRate)
+    {
+        buffer.reserve(64*1024);
+        start = std::chrono::steady_clock::now();
+        hasInput = false;
+        workingDirectory = GetWorkingDirectory();
+
+        PutU32(REPLAY_MAGIC);
+        PutU16(REPLAY_VERSION);
+        PutU16(static_cast<unsigned short>(tickRate));
+    }
+
+    void RecordInput(unsigned int frame, const InputState& input)
+    {
+        if (hasInput && input == lastInput) return;
+
+        BeginEvent(ReplayEventType::Input, frame);
+        PutU16(static_cast<unsigned short>(input.mouseX));
+        PutU16(static_cast<unsigned short>(input.mouseY));
+        PutU8(input.buttons);
+        PutF32(input.wheel);
+
+        lastInput = input;
+        hasInput = true;
+    }
+
+    void RecordParams(unsigned int frame, const SpriteParams& params)
+    {
+        BeginEvent(ReplayEventType::Params, frame);
+        PutF32(params.position.x);
+        PutF32(params.position.y);
+        PutF32(params.frameScale);
+        PutF32(params.frameSpeed);
+        PutF32(params.frameFacing);
+        PutI32(params.totalFrames);
+        PutU8(params.advanceRow ? 1 : 0);
+    }
+
+    void RecordRow(unsigned int frame, int selectedRow)
+    {
+        BeginEvent(ReplayEventType::Row, frame);
+        PutI32(selectedRow);
+    }
+
+    // Paths under the working directory are logged relative to it, so a log replays on another machine
+    void RecordLoadSheet(unsigned int frame, const char* path, int frameColumns, int frameRows, const ReplayLoadOptions& options)
+    {
+        const size_t base = workingDirectory.size();
+        if ((base > 0) && (strncmp(path, workingDirectory.c_str(), base) == 0) && ((path[base] == '/') || (path[base] == '\\'))) path += base + 1;
+
+        const size_t length = std::min(strlen(path), static_cast<size_t>(REPLAY_MAX_PATH - 1));
+
+        BeginEvent(ReplayEventType::LoadSheet, frame);
+        PutI32(frameColumns);
+        PutI32(frameRows);
+        PutU8((options.compactDuplicates ? 1 : 0) | (options.premultiplyAlpha ? 2 : 0));
+        PutU8(options.packMode);
+        PutI32(options.packTolerance);
+        PutU16(static_cast<unsigned short>(length));
+        Put(path, length);
+    }
+
+    void RecordClearSheet(unsigned int frame)
+    {
+        BeginEvent(ReplayEventType::ClearSheet, frame);
+    }
+
+    // Write the log, closing it with an end marker at the given frame
+    bool Save(const char* fileName, unsigned int frame)
+    {
+        BeginEvent(ReplayEventType::End, frame);
+        return SaveFileData(fileName, buffer.data(), static_cast<int>(buffer.size()));
+    }
+};
+
+// Reads a log written by InputRecorder and hands back its events frame by frame
+class InputReplay
+{
+private:
+    std::vector<unsigned char> buffer;
+    size_t cursor;
+    unsigned short version;
+    int tickRate;
+    unsigned int endFrame;
+    bool valid;
+    ReplayEvent pending;
+    bool hasPending;
+
+    bool Get(void* data, size_t size)
+    {
+        if (cursor + size > buffer.size()) return false;
+        memcpy(data, buffer.data() + cursor, size);
+        cursor += size;
+        return true;
+    }
+
+    bool GetU8(unsigned char& value) { return Get(&value, 1); }
+
+    bool GetU16(unsigned short& value)
+    {
+        unsigned char bytes[2];
+        if (!Get(bytes, 2)) return false;
+        value = static_cast<unsigned short>(bytes[0] | (bytes[1] << 8));
+        return true;
+    }
+
+    bool GetU32(unsigned int& value)
+    {
+        unsigned short lo, hi;
+        if (!GetU16(lo) || !GetU16(hi)) return false;
+        value = lo | (static_cast<unsigned int>(hi) << 16);
+        return true;
+    }
+
+    bool GetI32(int& value)
+    {
+        unsigned int bits;
+        if (!GetU32(bits)) return false;
+        value = static_cast<int>(bits);
+        return true;
+    }
+
+    bool GetF32(float& value)
+    {
+        unsigned int bits;
+        if (!GetU32(bits)) return false;
+        memcpy(&value, &bits, sizeof(value));
+        return true;
+    }
+
+    bool ReadEvent(ReplayEvent& event)
+    {
+        unsigned char type;
+        if (!GetU8(type) || !GetU32(event.frame) || !GetU32(event.timeUs)) return false;
+
+        event.type = static_cast<ReplayEventType>(type);
+
+        switch (event.type)
+        {
+            case ReplayEventType::Input:
+            {
+                unsigned short x, y;
+                if (!GetU16(x) || !GetU16(y) || !GetU8(event.input.buttons) || !GetF32(event.input.wheel)) return false;
+                event.input.mouseX = static_cast<short>(x);
+                event.input.mouseY = static_cast<short>(y);
+            } break;
+            case ReplayEventType::Params:
+            {
+                unsigned char advanceRow;
+                if (!GetF32(event.params.position.x) || !GetF32(event.params.position.y) ||
+                    !GetF32(event.params.frameScale) || !GetF32(event.params.frameSpeed) || !GetF32(event.params.frameFacing) ||
+                    !GetI32(event.params.totalFrames) || !GetU8(advanceRow)) return false;
+                event.params.advanceRow = (advanceRow != 0);
+            } break;
+            case ReplayEventType::Row: return GetI32(event.selectedRow);
+            case ReplayEventType::LoadSheet:
+            {
+                unsigned short length;
+                if (!GetI32(event.frameColumns) || !GetI32(event.frameRows)) return false;
+
+                // Logs from before the options were recorded loaded with everything off
+                event.loadOptions = ReplayLoadOptions{ false, false, 0, 0 };
+                if (version >= 2)
+                {
+                    unsigned char flags;
+                    if (!GetU8(flags) || !GetU8(event.loadOptions.packMode) || !GetI32(event.loadOptions.packTolerance)) return false;
+                    event.loadOptions.compactDuplicates = (flags & 1) != 0;
+                    event.loadOptions.premultiplyAlpha = (flags & 2) != 0;
+                }
+
+                if (!GetU16(length)) return false;
+                if (length >= REPLAY_MAX_PATH || !Get(event.path, length)) return false;
+                event.path[length] = '\0';
+            } break;
+            case ReplayEventType::ClearSheet:
+            case ReplayEventType::End: break;
+            default: return false;
+        }
+
+        return true;
+    }
+
+public:
+    InputReplay() : cursor(0), version(REPLAY_VERSION), tickRate(60), endFrame(0), valid(false), hasPending(false) {}
+
+    bool Load(const char* fileName)
+    {
+        int dataSize = 0;
+        unsigned char* data = LoadFileData(fileName, &dataSize);
+        if (data == nullptr) return false;
+
+        buffer.assign(data, data + dataSize);
+        UnloadFileData(data);
+
+        unsigned int magic;
+        unsigned short rate;
+        cursor = 0;
+        valid = GetU32(magic) && (magic == REPLAY_MAGIC) && GetU16(version) && (version >= 1) && (version <= REPLAY_VERSION) && GetU16(rate) && (rate > 0);
+        if (!valid) return false;
+
+        tickRate = rate;
+
+        // Find the end marker up front so the length of the session is known
+        const size_t eventsStart = cursor;
+        ReplayEvent event;
+        endFrame = 0;
+        while (ReadEvent(event))
+        {
+            endFrame = event.frame;
+            if (event.type == ReplayEventType::End) break;
+        }
+
+        cursor = eventsStart;
+        hasPending = false;
+        return true;
+    }
+
+    int GetTickRate() const
+    {
+        return tickRate;
+    }
+
+    unsigned int GetEndFrame() const
+    {
+        return endFrame;
+    }
+
+    bool IsFinished(unsigned int frame) const
+    {
+        return !valid || (frame >= endFrame);
+    }
+
+    // Next event recorded at or before the given frame, in recording order
+    bool Next(unsigned int frame, ReplayEvent& event)
+    {
+        if (!valid) return false;
+
+        if (!hasPending)
+        {
+            if (!ReadEvent(pending) || (pending.type == ReplayEventType::End)) return false;
+            hasPending = true;
+        }
+
+        if (pending.frame > frame) return false;
+
+        event = pending;
+        hasPending = false;
+        return true;
+    }
+};
+
+// Per-frame timings collected during a replay, with the memory the ledger held at the end of each frame
+class FrameTimingReport
+{
+private:
+    std::vector<float> frameMs;
+    std::vector<size_t> cpuBytes;
+    std::vector<size_t> gpuBytes;
+
+public:
+    void Reserve(size_t frames)
+    {
+        frameMs.reserve(frames);
+        cpuBytes.reserve(frames);
+        gpuBytes.reserve(frames);
+    }
+
+    void Add(float ms)
+    {
+        const MemoryLedger& ledger = GetMemoryLedger();
+        frameMs.push_back(ms);
+        cpuBytes.push_back(ledger.GetCpuBytes());
+        gpuBytes.push_back(ledger.GetGpuBytes());
+    }
+
+    void Print(FILE* out) const
+    {
+        if (frameMs.empty())
+        {
+            fprintf(out, "frames: 0\n");
+            return;
+        }
+
+        std::vector<float> sorted(frameMs);
+        std::sort(sorted.begin(), sorted.end());
+
+        double total = 0.0;
+        for (float ms : frameMs) total += ms;
+
+        const size_t count = sorted.size();
+        fprintf(out, "frames: %zu\n", count);
+        fprintf(out, "total: %.3f ms\n", total);
+        fprintf(out, "mean: %.4f ms\n", total/count);
+        fprintf(out, "min: %.4f ms\n", sorted.front());
+        fprintf(out, "p50: %.4f ms\n", sorted[count*50/100]);
+        fprintf(out, "p95: %.4f ms\n", sorted[std::min(count - 1, count*95/100)]);
+        fprintf(out, "p99: %.4f ms\n", sorted[std::min(count - 1, count*99/100)]);
+        fprintf(out, "max: %.4f ms\n", sorted.back());
+
+        const MemoryLedger& ledger = GetMemoryLedger();
+        fprintf(out, "memory peak: cpu %.2f MiB, gpu %.2f MiB\n",
+                BytesToMiB(*std::max_element(cpuBytes.begin(), cpuBytes.end())), BytesToMiB(*std::max_element(gpuBytes.begin(), gpuBytes.end())));
+        fprintf(out, "memory end: cpu %.2f MiB, gpu %.2f MiB\n", BytesToMiB(cpuBytes.back()), BytesToMiB(gpuBytes.back()));
+        fprintf(out, "memory budget: %.0f MiB, %u sheets downsampled, %u refused\n",
+                BytesToMiB(ledger.GetBudget()), ledger.GetDownsampled(), ledger.GetRefused());
+    }
+
+    // One line per frame: index, milliseconds and bytes held
+    bool SaveCsv(const char* fileName) const
+    {
+        FILE* file = fopen(fileName, "w");
+        if (file == nullptr) return false;
+
+        fprintf(file, "frame,ms,cpu_bytes,gpu_bytes\n");
+        for (size_t i = 0; i < frameMs.size(); i++) fprintf(file, "%zu,%.6f,%zu,%zu\n", i, frameMs[i], cpuBytes[i], gpuBytes[i]);
+
+        fclose(file);
+        return true;
+    }
+};
+
+// Replay a log without a window: the simulation is stepped once per recorded frame at a fixed timestep
+inline int RunHeadlessReplay(const char* logFileName, const char* csvFileName)
+{
+    InputReplay replay;
+    if (!replay.Load(logFileName))
+    {
+        fprintf(stderr, "Could not read replay log: %s\n", logFileName);
+        return 1;
+    }
+
+    Simulation simulation(replay.GetTickRate());
+    FrameTimingReport report;
+    report.Reserve(replay.GetEndFrame());
+
+    unsigned int sheetVersion = 0;
+    unsigned int rowVersion = 0;
+    ReplayEvent event;
+
+    // What the viewer would hold for the sheet it shows, there is no texture to hold without a window
+    MemoryCharge sheetMemory(MemoryPool::Sheet);
+    unsigned int skippedLoads = 0;
+
+    for (unsigned int frame = 0; !replay.IsFinished(frame); frame++)
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        while (replay.Next(frame, event))
+        {
+            switch (event.type)
+            {
+                case ReplayEventType::Params: simulation.Submit(SimCommand::Params(0, event.params)); break;
+                case ReplayEventType::Row: simulation.Submit(SimCommand::Row(0, ++rowVersion, event.selectedRow)); break;
+                case ReplayEventType::LoadSheet:
+                {
+                    // Only the sheet size and frame table matter to the simulation, no GPU upload needed. Sources with
+                    // their own grid ignore the recorded dropdowns, as they did in the viewer
+                    const bool ownGrid = HasOwnGrid(event.path);
+                    SheetSource source = LoadSheetSource(event.path, ownGrid ? 0 : event.frameColumns, ownGrid ? 0 : event.frameRows);
+                    if ((source.image.data == nullptr) || !source.error.empty())
+                    {
+                        fprintf(stderr, "Frame %u: could not load %s: %s\n", frame, event.path, source.error.empty() ? "no image" : source.error.c_str());
+                        UnloadImage(source.image);
+                        skippedLoads++;
+                        break;
+                    }
+
+                    // The same budget as the viewer, a refused sheet leaves the current one in place
+                    MemoryLedger& ledger = GetMemoryLedger();
+                    const SheetAdmission admission = AdmitSheet(&source.image, source.columns, source.rows, !source.frames, false,
+                                                                ledger.GetAvailable(sheetMemory.GetTotalBytes()), ledger.GetPolicy());
+                    ledger.CountAdmission(admission.result);
+
+                    if (admission.result == MemoryAdmission::Refused)
+                    {
+                        UnloadImage(source.image);
+                        break;
+                    }
+
+                    // Prepared with the recorded options, so compaction and packing cost what they did in the session.
+                    // The prepared image is what the viewer would have uploaded
+                    const int sheetWidth = source.image.width;
+                    const int sheetHeight = source.image.height;
+
+                    SpriteLoadOptions loadOptions;
+                    loadOptions.compactDuplicates = event.loadOptions.compactDuplicates;
+                    loadOptions.premultiplyAlpha = event.loadOptions.premultiplyAlpha;
+                    loadOptions.packMode = static_cast<PixelPackMode>(event.loadOptions.packMode);
+                    loadOptions.packTolerance = event.loadOptions.packTolerance;
+                    loadOptions.frameTable = source.frames;
+                    loadOptions.uploadTexture = false;
+                    loadOptions.deferUpload = true;
+
+                    SheetMemory memory;
+                    {
+                        const Sprite prepared(Vector2{ 0, 0 }, source.image, source.columns, source.rows, 1.0f, loadOptions);
+                        memory = prepared.GetMemory();
+                    }
+                    sheetMemory.Set(memory.GetCpuBytes() - memory.decodedBytes, memory.decodedBytes);
+
+                    simulation.Submit(SimCommand::Sheet(0, ++sheetVersion, sheetWidth, sheetHeight, source.columns, source.rows, source.frames));
+                } break;
+                case ReplayEventType::ClearSheet:
+                {
+                    sheetMemory.Set(0, 0);
+                    simulation.Submit(SimCommand::Clear(0, ++sheetVersion));
+                } break;
+                default: break;
+            }
+        }
+
+        simulation.Tick();
+        simulation.Acquire();
+
+        report.Add(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    printf("Replay: %s (%d Hz)\n", logFileName, replay.GetTickRate());
+    report.Print(stdout);
+    if (skippedLoads > 0) printf("skipped loads: %u\n", skippedLoads);
+
+    if ((csvFileName != nullptr) && !report.SaveCsv(csvFileName))
+    {
+        fprintf(stderr, "Could not write timings: %s\n", csvFileName);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,515 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define JOB_MAX_WORKERS 8
+#define JOB_UTILISATION_WINDOW_MS 500   // Worker utilisation is averaged over this long
+#define JOB_DEPTH_HISTORY 120           // Queue depth samples kept for the debug panel, one per frame
+
+// Interactive jobs are what the user is waiting on, and always run before background ones
+enum class JobPriority
+{
+    Interactive = 0,
+    Background,
+    Count
+};
+
+// Shared flag for jobs that are no longer wanted. A cancelled job that has not started is skipped;
+// one that is already running only stops if it checks IsCancelled() itself
+class CancelToken
+{
+private:
+    std::shared_ptr<std::atomic<bool>> flag;
+
+    explicit CancelToken(std::nullptr_t)
+    {
+    }
+
+public:
+    CancelToken() : flag(std::make_shared<std::atomic<bool>>(false))
+    {
+    }
+
+    // A token that is never cancelled, and costs no allocation
+    static CancelToken None()
+    {
+        return CancelToken(nullptr);
+    }
+
+    void Cancel()
+    {
+        if (flag) flag->store(true, std::memory_order_release);
+    }
+
+    bool IsCancelled() const
+    {
+        return flag && flag->load(std::memory_order_acquire);
+    }
+};
+
+// Jobs submitted with a counter are counted until they have run or been skipped,
+// so whatever they point into can wait for them before it goes away
+class JobCounter
+{
+private:
+    std::atomic<int> pending;
+    std::mutex mutex;
+    std::condition_variable done;
+
+public:
+    JobCounter() : pending(0)
+    {
+    }
+
+    void Add()
+    {
+        pending.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Under the lock, so a waiter cannot see 0 and destroy the counter before this is done with it
+    void Done()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) done.notify_all();
+    }
+
+    int GetPending() const
+    {
+        return pending.load(std::memory_order_acquire);
+    }
+
+    // Not from a job: the worker would block instead of running the jobs being waited for
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() { return pending.load(std::memory_order_acquire) == 0; });
+    }
+};
+
+// Work-stealing thread pool. Each worker has a deque per priority: jobs a worker submits go on its own deque
+// and it takes the newest first, idle workers steal the oldest from the others. Jobs from other threads wait
+// in a shared queue in the order they came. Work that needs the GL context is posted back to the main thread
+class JobSystem
+{
+private:
+    typedef std::chrono::steady_clock Clock;
+    static const int priorityCount = static_cast<int>(JobPriority::Count);
+
+    struct Job
+    {
+        std::function<void()> run;
+        CancelToken token;
+        JobCounter* counter;
+
+        Job() : token(CancelToken::None()), counter(nullptr)
+        {
+        }
+
+        Job(std::function<void()> run_, const CancelToken& token_, JobCounter* counter_) : run(std::move(run_)), token(token_), counter(counter_)
+        {
+        }
+    };
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Job> queues[priorityCount];
+        std::thread thread;
+
+        std::atomic<long long> busyNs;      // Total time spent running jobs
+        std::atomic<long long> busySince;   // Start of the running job, 0 when idle
+
+        // Main thread only
+        long long sampleBusyNs;
+        float utilisation;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    std::mutex injectMutex;
+    std::deque<Job> injected[priorityCount];
+
+    std::atomic<int> queued[priorityCount];
+    std::atomic<int> running;
+    std::atomic<unsigned int> completed;
+    std::atomic<unsigned int> stolen;
+    std::atomic<unsigned int> cancelled;
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    std::mutex mainMutex;
+    std::deque<std::function<void()>> mainQueue;
+    std::atomic<int> mainQueued;
+
+    // Debug panel samples, main thread only
+    long long sampleStartNs;
+    int depthHistory[JOB_DEPTH_HISTORY];
+    int depthCursor;
+
+    static long long NowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    // Pool and worker index of the calling thread, null and -1 outside any pool
+    static JobSystem*& CurrentPool()
+    {
+        static thread_local JobSystem* pool = nullptr;
+        return pool;
+    }
+
+    static int& CurrentWorker()
+    {
+        static thread_local int index = -1;
+        return index;
+    }
+
+    static bool PopBack(std::mutex& mutex, std::deque<Job>& queue, Job& job)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (queue.empty()) return false;
+
+        job = std::move(queue.back());
+        queue.pop_back();
+        return true;
+    }
+
+    static bool PopFront(std::mutex& mutex, std::deque<Job>& queue, Job& job)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (queue.empty()) return false;
+
+        job = std::move(queue.front());
+        queue.pop_front();
+        return true;
+    }
+
+    // Highest priority first: own deque, then the shared queue, then the oldest job of another worker
+    bool Take(int index, Job& job)
+    {
+        const int count = static_cast<int>(workers.size());
+
+        for (int p = 0; p < priorityCount; p++)
+        {
+            bool found = (index >= 0) && PopBack(workers[index]->mutex, workers[index]->queues[p], job);
+            if (!found) found = PopFront(injectMutex, injected[p], job);
+
+            for (int k = 1; !found && (k <= count); k++)
+            {
+                const int victim = (index + k) % count;
+                if (victim == index) continue;
+
+                found = PopFront(workers[victim]->mutex, workers[victim]->queues[p], job);
+                if (found) stolen.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            if (found)
+            {
+                queued[p].fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void Execute(Job& job)
+    {
+        if (job.token.IsCancelled()) cancelled.fetch_add(1, std::memory_order_relaxed);
+        else
+        {
+            running.fetch_add(1, std::memory_order_relaxed);
+            job.run();
+            running.fetch_sub(1, std::memory_order_relaxed);
+            completed.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Captures go before the counter lets a waiter tear down what they point into
+        JobCounter* counter = job.counter;
+        job = Job();
+        if (counter != nullptr) counter->Done();
+    }
+
+    void Run(int index)
+    {
+        CurrentPool() = this;
+        CurrentWorker() = index;
+
+        Worker& self = *workers[index];
+
+        for (;;)
+        {
+            Job job;
+            if (Take(index, job))
+            {
+                const long long start = NowNs();
+                self.busySince.store(start, std::memory_order_relaxed);
+                Execute(job);
+                self.busyNs.fetch_add(NowNs() - start, std::memory_order_relaxed);
+                self.busySince.store(0, std::memory_order_relaxed);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this]() { return stopping || (GetQueued() > 0); });
+            if (stopping) return;
+        }
+    }
+
+    // Jobs left when the pool stops never run, but their counters still hear about them
+    void DropQueued(std::deque<Job>& queue)
+    {
+        for (Job& job : queue)
+        {
+            if (job.counter != nullptr) job.counter->Done();
+            cancelled.fetch_add(1, std::memory_order_relaxed);
+        }
+        queue.clear();
+    }
+
+public:
+    // workerCount_ = 0 leaves one core for the main thread, with at least two workers
+    explicit JobSystem(int workerCount_ = 0) : running(0), completed(0), stolen(0), cancelled(0), stopping(false), mainQueued(0),
+        sampleStartNs(NowNs()), depthHistory{}, depthCursor(0)
+    {
+        for (int p = 0; p < priorityCount; p++) queued[p].store(0);
+
+        const int hardware = static_cast<int>(std::thread::hardware_concurrency());
+        const int count = (workerCount_ > 0) ? workerCount_ : std::min(std::max(hardware - 1, 2), JOB_MAX_WORKERS);
+
+        for (int i = 0; i < count; i++)
+        {
+            workers.push_back(std::unique_ptr<Worker>(new Worker()));
+            workers.back()->busyNs.store(0);
+            workers.back()->busySince.store(0);
+            workers.back()->sampleBusyNs = 0;
+            workers.back()->utilisation = 0.0f;
+        }
+
+        for (int i = 0; i < count; i++) workers[i]->thread = std::thread(&JobSystem::Run, this, i);
+    }
+
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+
+        wake.notify_all();
+        for (std::unique_ptr<Worker>& worker : workers) worker->thread.join();
+
+        for (int p = 0; p < priorityCount; p++)
+        {
+            DropQueued(injected[p]);
+            for (std::unique_ptr<Worker>& worker : workers) DropQueued(worker->queues[p]);
+        }
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // The pool the calling thread works for, null outside job workers
+    static JobSystem* GetCurrent()
+    {
+        return CurrentPool();
+    }
+
+    void Submit(JobPriority priority, std::function<void()> run, const CancelToken& token, JobCounter* counter = nullptr)
+    {
+        if (counter != nullptr) counter->Add();
+
+        Job job(std::move(run), token, counter);
+        const int p = static_cast<int>(priority);
+        const int index = (CurrentPool() == this) ? CurrentWorker() : -1;
+
+        if (index >= 0)
+        {
+            std::lock_guard<std::mutex> lock(workers[index]->mutex);
+            workers[index]->queues[p].push_back(std::move(job));
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(injectMutex);
+            injected[p].push_back(std::move(job));
+        }
+
+        queued[p].fetch_add(1, std::memory_order_relaxed);
+
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_one();
+    }
+
+    void Submit(JobPriority priority, std::function<void()> run)
+    {
+        Submit(priority, std::move(run), CancelToken::None());
+    }
+
+    // Call fn(i) for i in [0, count) as up to shares jobs, the caller taking one share itself.
+    // While it waits for the other shares the caller runs queued jobs, so a worker calling this never sits blocked
+    void ParallelFor(int count, int shares, const std::function<void(int)>& fn, JobPriority priority = JobPriority::Interactive)
+    {
+        std::atomic<int> next(0);
+        std::atomic<int> helpers(0);
+
+        auto work = [&]()
+        {
+            for (int i = next++; i < count; i = next++) fn(i);
+        };
+
+        const int helperCount = std::min(std::min(shares, count), static_cast<int>(workers.size()) + 1) - 1;
+        for (int i = 0; i < helperCount; i++)
+        {
+            helpers++;
+            Submit(priority, [&]()
+            {
+                work();
+                helpers--;
+            });
+        }
+
+        work();
+
+        // Usually one of our own helpers that nobody got to yet, it finds no items left and returns
+        const int index = (CurrentPool() == this) ? CurrentWorker() : -1;
+        while (helpers.load() > 0)
+        {
+            Job job;
+            if (Take(index, job)) Execute(job);
+            else std::this_thread::yield();
+        }
+    }
+
+    // Run fn on the main thread at its next RunMainContinuations(), for work that needs the GL context
+    void PostMain(std::function<void()> fn)
+    {
+        std::lock_guard<std::mutex> lock(mainMutex);
+        mainQueue.push_back(std::move(fn));
+        mainQueued.fetch_add(1, std::memory_order_release);
+    }
+
+    // Run posted continuations until none are left or budgetMs has passed, returns how many ran.
+    // Only an atomic load when nothing was posted, so it can run every frame
+    int RunMainContinuations(double budgetMs)
+    {
+        if (mainQueued.load(std::memory_order_acquire) == 0) return 0;
+
+        const Clock::time_point start = Clock::now();
+        int ran = 0;
+
+        do
+        {
+            std::function<void()> fn;
+            {
+                std::lock_guard<std::mutex> lock(mainMutex);
+                if (mainQueue.empty()) break;
+
+                fn = std::move(mainQueue.front());
+                mainQueue.pop_front();
+                mainQueued.fetch_sub(1, std::memory_order_relaxed);
+            }
+
+            fn();
+            ran++;
+        }
+        while (std::chrono::duration<double, std::milli>(Clock::now() - start).count() < budgetMs);
+
+        return ran;
+    }
+
+    // Once per frame on the main thread: queue depth history, and utilisation every JOB_UTILISATION_WINDOW_MS
+    void Sample()
+    {
+        depthHistory[depthCursor] = GetQueued();
+        depthCursor = (depthCursor + 1) % JOB_DEPTH_HISTORY;
+
+        const long long now = NowNs();
+        const long long elapsed = now - sampleStartNs;
+        if (elapsed < JOB_UTILISATION_WINDOW_MS*1000000LL) return;
+
+        for (std::unique_ptr<Worker>& worker : workers)
+        {
+            const long long since = worker->busySince.load(std::memory_order_relaxed);
+            const long long busy = worker->busyNs.load(std::memory_order_relaxed) + ((since != 0) ? now - since : 0);
+
+            worker->utilisation = std::min(std::max(static_cast<float>(busy - worker->sampleBusyNs)/elapsed, 0.0f), 1.0f);
+            worker->sampleBusyNs = busy;
+        }
+
+        sampleStartNs = now;
+    }
+
+    int GetWorkerCount() const
+    {
+        return static_cast<int>(workers.size());
+    }
+
+    // Share of the last sample window the worker spent running jobs, 0 to 1
+    float GetUtilisation(int worker) const
+    {
+        return workers[worker]->utilisation;
+    }
+
+    bool IsWorkerBusy(int worker) const
+    {
+        return workers[worker]->busySince.load(std::memory_order_relaxed) != 0;
+    }
+
+    // Submitted and not yet started
+    int GetQueued(JobPriority priority) const
+    {
+        return std::max(queued[static_cast<int>(priority)].load(std::memory_order_relaxed), 0);
+    }
+
+    int GetQueued() const
+    {
+        int total = 0;
+        for (int p = 0; p < priorityCount; p++) total += GetQueued(static_cast<JobPriority>(p));
+        return total;
+    }
+
+    int GetRunning() const
+    {
+        return running.load(std::memory_order_relaxed);
+    }
+
+    int GetMainQueued() const
+    {
+        return mainQueued.load(std::memory_order_relaxed);
+    }
+
+    unsigned int GetCompleted() const
+    {
+        return completed.load(std::memory_order_relaxed);
+    }
+
+    unsigned int GetStolen() const
+    {
+        return stolen.load(std::memory_order_relaxed);
+    }
+
+    unsigned int GetCancelled() const
+    {
+        return cancelled.load(std::memory_order_relaxed);
+    }
+
+    // Queued jobs ago frames back, 0 is the last sample
+    int GetDepthHistory(int ago) const
+    {
+        return depthHistory[(depthCursor - 1 - ago + 2*JOB_DEPTH_HISTORY) % JOB_DEPTH_HISTORY];
+    }
+};
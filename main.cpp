@@ -1,6 +1,19 @@
 #include "sprite.h"
+#include "simulation.h"
+#include "input_replay.h"
+#include "image_prefetch.h"
+#include "preview_daemon.h"
+#include "sheet_source.h"
+#include "frame_pacer.h"
+#include "job_system.h"
+#include "onion_skin.h"
+#include "memory_budget.h"
 #include "assert.h"
 
+#define ALLOC_TRACKER_IMPLEMENTATION
+#include "alloc_tracker.h"
+
+#include <chrono>
 #include <string>
 #include <memory>
 
@@ -10,13 +23,18 @@
 #undef RAYGUI_IMPLEMENTATION // Avoid including raygui implementation again
 #define GUI_WINDOW_FILE_DIALOG_IMPLEMENTATION
 #include "gui_window_file_dialog.h"
+#include "gui_asset_search.h"
 
 const int screenWidth = 1024;
 const int screenHeight = 768;
 
 #define GRID_SIZE 72
+#define PREFETCH_NEIGHBOURS 2
+#define MAIN_CONTINUATION_BUDGET_MS 4.0  // Texture uploads and other finished work run on the main thread for at most this long per frame
+#define ALLOC_CHECK_WARMUP 60   // Frames --alloc-check lets pass first, for the first upload and driver warm-up
 
-static void DrawGrid(int x, int y, int width, int height)
+template <typename Canvas>
+static void DrawGrid(Canvas& canvas, int x, int y, int width, int height)
 {
     int cellWidth = width / GRID_SIZE;
     int cellHeight = height / GRID_SIZE;
@@ -26,24 +44,28 @@ static void DrawGrid(int x, int y, int width, int height)
         for (int col = 0; col < GRID_SIZE; col++)
         {
             Color color = ((row + col) % 2 == 0) ? LIGHTGRAY : DARKGRAY;
-            DrawRectangle(x + col * cellWidth, y + row * cellHeight, cellWidth, cellHeight, color);
+            canvas.DrawRectangle(x + col * cellWidth, y + row * cellHeight, cellWidth, cellHeight, color);
         }
     }
 }
 
-static void DrawTexturePreview(const Vector2& pos, const Sprite* sprite, int width, int height)
+template <typename Canvas>
+static void DrawTexturePreview(Canvas& canvas, const Vector2& pos, const Sprite* sprite, const Rectangle& frameRec, int width, int height)
 {
     const int textureWidth = width;
     const int textureHeight = height;
 
     // Draw the full texture boundary
-    DrawRectangleLinesEx((Rectangle){pos.x, pos.y, static_cast<float>(textureWidth), static_cast<float>(textureHeight)}, 2.5f, GRAY);
+    canvas.DrawRectangleLinesEx((Rectangle){pos.x, pos.y, static_cast<float>(textureWidth), static_cast<float>(textureHeight)}, 2.5f, GRAY);
 
     if (sprite != nullptr)
     {
-        const Texture2D texture {sprite->GetTexture()};
+        const auto& texture = sprite->GetSheet(canvas);
+        const Rectangle sourceRec = sprite->GetSourceRec(frameRec);
+
+        if (sprite->IsPremultiplied()) canvas.BeginBlendMode(BLEND_ALPHA_PREMULTIPLY);
 
-        DrawTexturePro(
+        canvas.DrawTexturePro(
             texture,
             (Rectangle){0, 0, static_cast<float>(texture.width), static_cast<float>(texture.height)}, // Use full texture
             (Rectangle){pos.x, pos.y, static_cast<float>(textureWidth), static_cast<float>(textureHeight)},
@@ -52,43 +74,622 @@ static void DrawTexturePreview(const Vector2& pos, const Sprite* sprite, int wid
             WHITE            // No tint
         );
 
-        const Rectangle frameRec = sprite->GetFrameRec();
+        if (sprite->IsPremultiplied()) canvas.EndBlendMode();
 
         // Compute scaling factors from original texture to fixed size
         const float scaleX = textureWidth/static_cast<float>(texture.width);
         const float scaleY = textureHeight/static_cast<float>(texture.height);
 
         // Draw scaled frameRec inside the scaled texture
-        DrawRectangleLines(
-            pos.x + frameRec.x*scaleX,
-            pos.y + frameRec.y*scaleY,
-            frameRec.width*scaleX,
-            frameRec.height*scaleY,
+        canvas.DrawRectangleLines(
+            pos.x + sourceRec.x*scaleX,
+            pos.y + sourceRec.y*scaleY,
+            sourceRec.width*scaleX,
+            sourceRec.height*scaleY,
             RED
         );
     }
 }
 
-int main()
+// The onion skin lives in a render texture, so only the GPU path shows it
+static void DrawOnionSkin(GpuCanvas&, const OnionSkin& onionSkin, const SpriteSnapshot& frame)
+{
+    onionSkin.Draw(frame.position);
+}
+
+static void DrawOnionSkin(SoftCanvas&, const OnionSkin&, const SpriteSnapshot&)
+{
+}
+
+// Everything in the viewer that is not UI. frame is null while no simulated frame is available,
+// onionSkin while no ghosts are shown
+template <typename Canvas>
+static void DrawScene(Canvas& canvas, const Sprite* sprite, const SpriteSnapshot* frame, const OnionSkin* onionSkin = nullptr)
+{
+    const Vector2 texturePos {screenWidth - 565, screenHeight - 350};
+    DrawTexturePreview(canvas, texturePos, sprite, (frame != nullptr) ? frame->frameRec : Rectangle{0, 0, 0, 0}, 560, 340);
+
+    int gridWidth = 480;
+    int gridHeight = 480;
+
+    DrawGrid(canvas, 20, 70, gridWidth, gridHeight);
+
+    if ((sprite != nullptr) && (frame != nullptr))
+    {
+        if (onionSkin != nullptr) DrawOnionSkin(canvas, *onionSkin, *frame);
+        sprite->Draw(canvas, *frame);
+    }
+}
+
+// Hitbox rectangles of the drawn frame, mirrored with it
+static void DrawHitboxes(const Sprite& sprite, const SpriteSnapshot& frame)
+{
+    const int mask = sprite.GetMaskIndex(frame);
+    if (mask < 0) return;
+
+    const Rectangle box = sprite.GetDrawnBox(frame);
+    const float scale = sprite.GetDrawScale(frame);
+
+    int count = 0;
+    const Rectangle* rects = sprite.GetMasks().GetHitboxes(mask, &count);
+    for (int i = 0; i < count; i++)
+    {
+        const float x = (frame.frameFacing < 0) ? box.width/scale - rects[i].x - rects[i].width : rects[i].x;
+        DrawRectangleLinesEx(Rectangle{ box.x + x*scale, box.y + rects[i].y*scale, rects[i].width*scale, rects[i].height*scale }, 1.0f, GREEN);
+    }
+}
+
+// A sheet load running as a job; the main thread finishes it once the job posts it back
+struct SheetLoad
+{
+    unsigned int version;
+    std::string path;
+    bool ownGrid;               // The source decides its grid, columns and rows come back from the job
+    int columns;
+    int rows;
+    Vector2 position;
+    float facing;
+    SpriteLoadOptions options;
+    size_t replacedBytes;       // Held by the sheet on screen, freed when this one replaces it
+
+    // Filled in by the job
+    std::unique_ptr<Sprite> sprite;
+    std::string info;
+    std::string error;
+    SheetAdmission admission;
+};
+
+// Decode and prepare a sheet on a job worker, leaving only the texture upload for the main thread
+static void RunSheetLoad(SheetLoad& load, ImagePrefetcher& prefetcher, const CancelToken& cancel)
+{
+    Image image = { 0 };
+
+    // An image with a sidecar only takes its grid from it once the sidecar parsed, otherwise the dropdowns' grid stays
+    if (load.ownGrid || HasFrameSidecar(load.path.c_str()))
+    {
+        SheetSource source = LoadSheetSource(load.path.c_str(), load.ownGrid ? 0 : load.columns, load.ownGrid ? 0 : load.rows);
+        if (source.image.data == nullptr)
+        {
+            load.error = source.error;
+            return;
+        }
+
+        image = source.image;
+        load.ownGrid = source.ownGrid;
+        load.columns = source.columns;
+        load.rows = source.rows;
+        load.info = source.info;
+        load.options.frameTable = source.frames;
+    }
+    else if (!prefetcher.Take(load.path.c_str(), image)) image = LoadImage(load.path.c_str());
+
+    if (image.data == nullptr)
+    {
+        load.error = std::string("Could not load ") + GetFileName(load.path.c_str());
+        return;
+    }
+
+    // Replaced by a newer load while decoding, skip the rest of the work
+    if (cancel.IsCancelled())
+    {
+        UnloadImage(image);
+        return;
+    }
+
+    // Keep within the memory budget: a grid sheet that is too big has its cells shrunk, anything else is refused.
+    // Images decoded on speculation make room first, the one asked for matters more
+    MemoryLedger& ledger = GetMemoryLedger();
+    const size_t neededBytes = EstimateSheetMemory(image.width, image.height, load.options.keepSoftTexture).GetTotalBytes();
+    const size_t availableBytes = ledger.GetAvailable(load.replacedBytes);
+    if (neededBytes > availableBytes) prefetcher.Release(neededBytes - availableBytes);
+
+    load.admission = AdmitSheet(&image, load.columns, load.rows, !load.options.frameTable, load.options.keepSoftTexture,
+                                ledger.GetAvailable(load.replacedBytes), ledger.GetPolicy());
+    ledger.CountAdmission(load.admission.result);
+
+    if (load.admission.result == MemoryAdmission::Refused)
+    {
+        char error[256];
+        snprintf(error, sizeof(error), "%s needs about %.1f MiB, the memory budget has %.1f MiB left", GetFileName(load.path.c_str()),
+                 BytesToMiB(load.admission.neededBytes), BytesToMiB(load.admission.availableBytes));
+        load.error = error;
+        UnloadImage(image);
+        return;
+    }
+
+    load.options.deferUpload = true;
+    load.options.sourceShrink = load.admission.shrink;
+    load.sprite = std::make_unique<Sprite>(load.position, image, load.columns, load.rows, load.facing, load.options);
+}
+
+// Queue depth, worker utilisation and job counts of the job system
+static void DrawJobPanel(const JobSystem& jobs, Rectangle bounds)
+{
+    DrawText(TextFormat("Queued: %d interactive, %d background | running %d | main thread %d",
+                        jobs.GetQueued(JobPriority::Interactive), jobs.GetQueued(JobPriority::Background), jobs.GetRunning(), jobs.GetMainQueued()),
+             bounds.x, bounds.y, 9, DARKGRAY);
+    DrawText(TextFormat("Jobs: %u completed, %u stolen, %u cancelled", jobs.GetCompleted(), jobs.GetStolen(), jobs.GetCancelled()),
+             bounds.x, bounds.y + 12, 9, DARKGRAY);
+
+    // One bar per worker, utilisation over the last sample window
+    const int workerCount = std::min(jobs.GetWorkerCount(), JOB_MAX_WORKERS);
+    for (int i = 0; i < workerCount; i++)
+    {
+        const float y = bounds.y + 28 + i*11;
+        const float utilisation = jobs.GetUtilisation(i);
+
+        DrawText(TextFormat("Worker %d", i), bounds.x, y, 9, jobs.IsWorkerBusy(i) ? DARKGREEN : GRAY);
+        DrawRectangleLinesEx(Rectangle{ bounds.x + 60, y, 200, 9 }, 1.0f, LIGHTGRAY);
+        DrawRectangleRec(Rectangle{ bounds.x + 60, y, 200*utilisation, 9 }, DARKBLUE);
+        DrawText(TextFormat("%3.0f%%", utilisation*100.0f), bounds.x + 266, y, 9, DARKGRAY);
+    }
+
+    // Queued jobs over the last frames, newest on the right
+    const Rectangle plot { bounds.x, bounds.y + bounds.height - 30, bounds.width, 30 };
+    DrawRectangleLinesEx(plot, 1.0f, LIGHTGRAY);
+
+    int largest = 1;
+    for (int i = 0; i < JOB_DEPTH_HISTORY; i++) largest = std::max(largest, jobs.GetDepthHistory(i));
+
+    const float barWidth = plot.width/JOB_DEPTH_HISTORY;
+    for (int i = 0; i < JOB_DEPTH_HISTORY; i++)
+    {
+        const float height = (plot.height - 2)*jobs.GetDepthHistory(i)/largest;
+        DrawRectangleRec(Rectangle{ plot.x + plot.width - (i + 1)*barWidth, plot.y + plot.height - 1 - height, barWidth, height }, ORANGE);
+    }
+    DrawText(TextFormat("Queue depth, peak %d", largest), plot.x + 4, plot.y + 2, 9, GRAY);
+}
+
+// CPU and GPU memory by pool against the budget, and what the sheet on screen holds
+static void DrawMemoryPanel(const MemoryLedger& ledger, const Sprite* sprite, Rectangle bounds)
+{
+    const size_t total = ledger.GetTotalBytes();
+    const size_t budget = ledger.GetBudget();
+
+    DrawText(TextFormat("Total: CPU %.1f MiB, GPU %.1f MiB | peak %.1f MiB | loads downsampled %u, refused %u",
+                        BytesToMiB(ledger.GetCpuBytes()), BytesToMiB(ledger.GetGpuBytes()), BytesToMiB(ledger.GetPeakBytes()),
+                        ledger.GetDownsampled(), ledger.GetRefused()), bounds.x, bounds.y, 9, DARKGRAY);
+
+    // Budget use, red once over it
+    const Rectangle bar { bounds.x, bounds.y + 14, bounds.width, 9 };
+    DrawRectangleLinesEx(bar, 1.0f, LIGHTGRAY);
+    if (budget > 0)
+    {
+        const float used = std::min(static_cast<float>(static_cast<double>(total)/budget), 1.0f);
+        DrawRectangleRec(Rectangle{ bar.x, bar.y, bar.width*used, bar.height }, (total > budget) ? RED : DARKGREEN);
+    }
+    DrawText((budget > 0) ? TextFormat("%.1f of %.0f MiB", BytesToMiB(total), BytesToMiB(budget)) : "No budget", bar.x + 4, bar.y, 9, DARKGRAY);
+
+    DrawText("Pool", bounds.x, bounds.y + 30, 9, GRAY);
+    DrawText("CPU", bounds.x + 120, bounds.y + 30, 9, GRAY);
+    DrawText("GPU", bounds.x + 220, bounds.y + 30, 9, GRAY);
+    for (int i = 0; i < static_cast<int>(MemoryPool::Count); i++)
+    {
+        const MemoryPool pool = static_cast<MemoryPool>(i);
+        const float y = bounds.y + 42 + i*11;
+
+        DrawText(GetMemoryPoolName(pool), bounds.x, y, 9, DARKGRAY);
+        DrawText(TextFormat("%8.2f MiB", BytesToMiB(ledger.GetCpuBytes(pool))), bounds.x + 120, y, 9, DARKGRAY);
+        DrawText(TextFormat("%8.2f MiB", BytesToMiB(ledger.GetGpuBytes(pool))), bounds.x + 220, y, 9, DARKGRAY);
+    }
+
+    if (sprite != nullptr)
+    {
+        const SheetMemory memory = sprite->GetMemory();
+        const float y = bounds.y + 42 + static_cast<int>(MemoryPool::Count)*11 + 8;
+
+        DrawText(TextFormat("Sheet %dx%d: texture %.2f MiB, waiting upload %.2f MiB", sprite->GetSheetWidth(), sprite->GetSheetHeight(),
+                            BytesToMiB(memory.textureBytes), BytesToMiB(memory.decodedBytes)), bounds.x, y, 9, DARKGRAY);
+        DrawText(TextFormat("CPU copy %.2f MiB, masks %.3f MiB, tables %.3f MiB",
+                            BytesToMiB(memory.softBytes), BytesToMiB(memory.maskBytes), BytesToMiB(memory.tableBytes)), bounds.x, y + 11, 9, DARKGRAY);
+    }
+}
+
+// Histogram of frame-to-frame deltas with the target interval marked, and frames shown against the ideal timeline
+static void DrawJitterPanel(const FrameJitterStats& jitter, const FramePacer& pacer, Rectangle bounds)
+{
+    DrawText(TextFormat("Delta: mean %.2f ms, sd %.3f, min %.2f, max %.2f, p99 %.2f | late %u of %u",
+                        jitter.GetMeanMs(), jitter.GetDeviationMs(), jitter.GetMinMs(), jitter.GetMaxMs(),
+                        jitter.GetPercentileMs(0.99), jitter.GetLateFrames(), jitter.GetDeltaCount()), bounds.x, bounds.y, 9, DARKGRAY);
+    DrawText(TextFormat("Pacer: slept %.2f ms, spun %.2f ms, spin window %.2f ms, resyncs %u",
+                        pacer.GetSleepMs(), pacer.GetSpinMs(), pacer.GetSpinWindowMs(), pacer.GetResyncs()), bounds.x, bounds.y + 12, 9, DARKGRAY);
+
+    const Rectangle plot { bounds.x, bounds.y + 28, bounds.width, bounds.height - 58 };
+    DrawRectangleLinesEx(plot, 1.0f, LIGHTGRAY);
+
+    const int binCount = jitter.GetBinCount();
+    const float barWidth = plot.width/binCount;
+    const unsigned int largest = jitter.GetLargestBin();
+
+    for (int i = 0; (i < binCount) && (largest > 0); i++)
+    {
+        const float height = (plot.height - 2)*jitter.GetBin(i)/largest;
+        const Color color = (i == binCount - 1) ? RED : ((i*jitter.GetBinMs() > 1.5*jitter.GetPeriodMs()) ? ORANGE : DARKBLUE);
+        DrawRectangleRec(Rectangle{ plot.x + i*barWidth + 1, plot.y + plot.height - 1 - height, std::max(barWidth - 1, 1.0f), height }, color);
+    }
+
+    // The target interval sits in the middle of the range
+    const float targetX = plot.x + barWidth*(binCount - 1)/2;
+    DrawLineV(Vector2{ targetX, plot.y }, Vector2{ targetX, plot.y + plot.height }, MAROON);
+
+    DrawText("0", plot.x, plot.y + plot.height + 2, 9, GRAY);
+    DrawText(TextFormat("%.2f ms", jitter.GetPeriodMs()), targetX - 16, plot.y + plot.height + 2, 9, MAROON);
+    DrawText(TextFormat(">%.1f", 2*jitter.GetPeriodMs()), plot.x + plot.width - 30, plot.y + plot.height + 2, 9, GRAY);
+
+    DrawText(TextFormat("Animation: %u frames, %u dropped, %u duplicated", jitter.GetAnimationFrames(), jitter.GetDroppedFrames(),
+                        jitter.GetDuplicatedFrames()), bounds.x, bounds.y + bounds.height - 14, 9, DARKGRAY);
+}
+
+// Build the masks of a sheet and write every frame's hitboxes as JSON
+static int ExportHitboxes(const char* sheetPath, int columns, int rows, const char* outputPath)
+{
+    SheetSource source = LoadSheetSource(sheetPath, columns, rows);
+    if ((source.image.data == nullptr) || (source.columns <= 0) || (source.rows <= 0))
+    {
+        fprintf(stderr, "%s\n", source.error.empty() ? "Columns and rows must be > 0" : source.error.c_str());
+        if (source.image.data != nullptr) UnloadImage(source.image);
+        return 1;
+    }
+
+    SpriteLoadOptions loadOptions;
+    loadOptions.uploadTexture = false;
+    loadOptions.frameTable = source.frames;
+
+    const Sprite sprite(Vector2{0, 0}, source.image, source.columns, source.rows, 1.0f, loadOptions);
+    const FrameMaskSet& masks = sprite.GetMasks();
+
+    if (!ExportFrameHitboxes(masks, outputPath)) return 1;
+
+    printf("%d frames, %zu bytes of masks built in %.2f ms on %d threads -> %s\n", masks.GetFrameCount(), masks.GetByteSize(),
+           masks.GetBuildMs(), masks.GetThreadCount(), outputPath);
+    return 0;
+}
+
+// Render one frame of a sheet on the CPU backend and save it, needs no window or GPU
+static int RenderFrameToFile(const char* sheetPath, int columns, int rows, int row, int frame, float scale, float facing, const char* outputPath)
+{
+    if ((columns <= 0) || (rows <= 0)) return 1;
+
+    SpriteLoadOptions loadOptions;
+    loadOptions.uploadTexture = false;
+    loadOptions.keepSoftTexture = true;
+
+    const Sprite sprite(Vector2{50, 100}, sheetPath, columns, rows, facing, loadOptions);
+    if (!sprite.HasSoftTexture()) return 1;
+
+    const SpriteSnapshot snapshot = sprite.GetFrameSnapshot(Vector2{50, 100}, row, frame, scale, facing);
+
+    SoftCanvas canvas(screenWidth, screenHeight);
+
+    // No window here, and GetTime() stays at 0 until one is opened
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    canvas.ClearBackground(WHITE);
+    DrawScene(canvas, &sprite, &snapshot);
+
+    const double renderMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("Rendered %s row %d frame %d in %.3f ms on %d threads\n", sheetPath, row, frame, renderMs, canvas.GetThreadCount());
+
+    Image image = canvas.ToImage();
+    const bool exported = ExportImage(image, outputPath);
+    UnloadImage(image);
+
+    return exported ? 0 : 1;
+}
+
+// --alloc-check without a window or GPU: the simulation stepped once per frame and the scene drawn on a SoftCanvas.
+// Fails if any frame after warm-up allocates, on the main thread or any other. The UI and the GpuCanvas need a
+// GL context, only the windowed --alloc-check covers them
+static int RunHeadlessAllocCheck(int frames, const char* sheetPath, int columns, int rows)
+{
+    std::unique_ptr<Sprite> sprite;
+    Simulation simulation;
+
+    if (sheetPath != nullptr)
+    {
+        if ((columns <= 0) || (rows <= 0)) return 1;
+
+        SpriteLoadOptions loadOptions;
+        loadOptions.uploadTexture = false;
+        loadOptions.keepSoftTexture = true;
+
+        sprite = std::make_unique<Sprite>(Vector2{50, 100}, sheetPath, columns, rows, 1.0f, loadOptions);
+        if (!sprite->HasSoftTexture()) return 1;
+
+        simulation.Submit(SimCommand::Params(0, SpriteParams{ Vector2{50, 100}, 3.0f, 8.0f, 1.0f, columns, false }));
+        simulation.Submit(SimCommand::Sheet(0, 1, sprite->GetSheetWidth(), sprite->GetSheetHeight(), columns, rows, sprite->GetFrameTable()));
+    }
+
+    SoftCanvas canvas(screenWidth, screenHeight);
+    AllocFrameProfile allocProfile;
+    unsigned int allocFrames = 0;
+    unsigned int allocFirstFrame = 0;
+
+    for (unsigned int frameIndex = 0; frameIndex < ALLOC_CHECK_WARMUP + static_cast<unsigned int>(frames); frameIndex++)
+    {
+        allocProfile.Enter(AllocPhase::Sync);
+        simulation.Tick();
+        const SimSpriteState& spriteState = simulation.Acquire().sprites[0];
+
+        allocProfile.Enter(AllocPhase::Scene);
+        canvas.ClearBackground(WHITE);
+        DrawScene(canvas, sprite.get(), spriteState.active ? &spriteState.frame : nullptr);
+
+        allocProfile.EndFrame();
+
+        const AllocCount allocs = allocProfile.GetFrame();
+        const AllocCount others = allocProfile.GetOtherThreads();
+        if ((frameIndex >= ALLOC_CHECK_WARMUP) && ((allocs.count > 0) || (others.count > 0)))
+        {
+            if (allocFrames++ == 0) allocFirstFrame = frameIndex;
+            fprintf(stderr, "ALLOC: frame %u made %llu allocations (%llu bytes), most in %s, and %llu on other threads\n", frameIndex,
+                    allocs.count, allocs.bytes, GetAllocPhaseName(allocProfile.GetWorstPhase()), others.count);
+        }
+    }
+
+    if (allocFrames == 0) printf("Allocation check (headless): no allocations in %d idle frames\n", frames);
+    else printf("Allocation check (headless): %u of %d idle frames allocated, first at frame %u\n", allocFrames, frames, allocFirstFrame);
+
+    return (allocFrames > 0) ? 1 : 0;
+}
+
+// Per-pixel comparison against a reference render, fails when any pixel is off by more than tolerance
+static int CompareImageFiles(const char* imagePath, const char* referencePath, int tolerance)
+{
+    Image image = LoadImage(imagePath);
+    Image reference = LoadImage(referencePath);
+
+    ImageDiff diff;
+    const bool compared = CompareImages(image, reference, tolerance, &diff);
+
+    if (compared)
+    {
+        printf("%d of %d pixels differ by more than %d (max error %d, mean %.4f)\n", diff.mismatched, diff.pixelCount, tolerance, diff.maxError, diff.meanError);
+    }
+    else fprintf(stderr, "Cannot compare %s with %s\n", imagePath, referencePath);
+
+    UnloadImage(image);
+    UnloadImage(reference);
+
+    return (compared && (diff.mismatched == 0)) ? 0 : 1;
+}
+
+// Draw the current scene on both backends and save both, so the CPU output can be checked against the GPU
+static void SaveBackendComparison(Sprite* sprite, const SpriteSnapshot* frame)
+{
+    if (sprite != nullptr) sprite->LoadSoftTextureFromGpu();
+
+    RenderTexture2D target = LoadRenderTexture(screenWidth, screenHeight);
+    GpuCanvas gpuCanvas;
+
+    BeginTextureMode(target);
+    ClearBackground(WHITE);
+    DrawScene(gpuCanvas, sprite, frame);
+    EndTextureMode();
+
+    Image gpuImage = LoadImageFromTexture(target.texture);
+    ImageFlipVertical(&gpuImage);
+    UnloadRenderTexture(target);
+
+    SoftCanvas softCanvas(screenWidth, screenHeight);
+    softCanvas.ClearBackground(WHITE);
+    DrawScene(softCanvas, sprite, frame);
+    Image softImage = softCanvas.ToImage();
+
+    ExportImage(gpuImage, "render_gpu.png");
+    ExportImage(softImage, "render_cpu.png");
+
+    ImageDiff diff;
+    if (CompareImages(softImage, gpuImage, 0, &diff))
+    {
+        TraceLog(LOG_INFO, "RENDER: CPU vs GPU: %d of %d pixels differ, max error %d, mean %.4f", diff.mismatched, diff.pixelCount, diff.maxError, diff.meanError);
+    }
+
+    UnloadImage(gpuImage);
+    UnloadImage(softImage);
+}
+
+// "0;1;...;count", the grid dropdowns grow when an imported folder needs a larger grid
+static std::string MakeCountOptions(int count)
+{
+    std::string options("0");
+    for (int i = 1; i <= count; i++) options += TextFormat(";%d", i);
+    return options;
+}
+
+// Tag names for the row dropdown, in tag order
+static std::string MakeTagOptions(const FrameTable& frameTable)
+{
+    std::string options;
+    for (int i = 0; i < frameTable.GetTagCount(); i++)
+    {
+        if (i > 0) options += ';';
+
+        std::string name = frameTable.GetTagName(i);
+        std::replace(name.begin(), name.end(), ';', ',');
+        options += name.empty() ? TextFormat("Tag %d", i + 1) : name.c_str();
+    }
+
+    return options;
+}
+
+// Ask for the focused dialog entry first, then its list neighbours outwards
+static void RequestPrefetch(ImagePrefetcher& prefetcher, const FilePathList& files, int focused)
+{
+    const char* wanted[1 + 2*PREFETCH_NEIGHBOURS];
+    int count = 0;
+
+    for (int i = 0; i <= 2*PREFETCH_NEIGHBOURS; i++)
+    {
+        const int offset = (i + 1)/2*((i % 2 == 0) ? -1 : 1);
+        const int index = focused + offset;
+
+        if ((index < 0) || (index >= static_cast<int>(files.count))) continue;
+        if (IsPathFile(files.paths[index]) && IsFileExtension(files.paths[index], ".png")) wanted[count++] = files.paths[index];
+    }
+
+    prefetcher.Request(wanted, count);
+}
+
+int main(int argc, char** argv)
 {   
+    // Command line: --record <log>, --replay <log>, --headless, --timings <csv>,
+    // --compact-sheet <sheet> <columns> <rows> <output>,
+    // --render <sheet> <columns> <rows> <row> <frame> <scale> <facing> <output>, --compare <image> <reference> [tolerance],
+    // --daemon <socket>, --preview <socket> <sheet> <columns> <rows> <row> <frame> <scale> <facing> <output>,
+    // --import-frames <folder or pattern> <output> [columns], --alloc-check <frames> [<sheet> <columns> <rows>] [--headless],
+    // --export-hitboxes <sheet> <columns> <rows> <output>, --fps <rate>, --memory-budget <MiB> [refuse]
+    const char* recordFileName = nullptr;
+    const char* replayFileName = nullptr;
+    const char* timingsFileName = nullptr;
+    bool headless = false;
+    int targetFps = 60;     // 0 runs unpaced
+    int memoryBudgetMiB = 0;    // 0 for no budget
+    bool refuseOversize = false;
+
+    // Run the idle viewer and fail if its steady-state frames allocate
+    int allocCheckFrames = 0;
+    const char* allocCheckSheet = nullptr;
+    int allocCheckColumns = 0;
+    int allocCheckRows = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "--record") == 0) && (i + 1 < argc)) recordFileName = argv[++i];
+        else if ((strcmp(argv[i], "--replay") == 0) && (i + 1 < argc)) replayFileName = argv[++i];
+        else if ((strcmp(argv[i], "--timings") == 0) && (i + 1 < argc)) timingsFileName = argv[++i];
+        else if (strcmp(argv[i], "--headless") == 0) headless = true;
+        else if ((strcmp(argv[i], "--fps") == 0) && (i + 1 < argc)) targetFps = std::max(0, atoi(argv[++i]));
+        else if ((strcmp(argv[i], "--memory-budget") == 0) && (i + 1 < argc))
+        {
+            memoryBudgetMiB = std::max(0, atoi(argv[++i]));
+            if ((i + 1 < argc) && (strcmp(argv[i + 1], "refuse") == 0))
+            {
+                refuseOversize = true;
+                i++;
+            }
+        }
+        else if ((strcmp(argv[i], "--alloc-check") == 0) && (i + 1 < argc))
+        {
+            allocCheckFrames = std::max(1, atoi(argv[++i]));
+            if ((i + 3 < argc) && (argv[i + 1][0] != '-'))
+            {
+                allocCheckSheet = argv[i + 1];
+                allocCheckColumns = atoi(argv[i + 2]);
+                allocCheckRows = atoi(argv[i + 3]);
+                i += 3;
+            }
+        }
+        else if ((strcmp(argv[i], "--import-frames") == 0) && (i + 2 < argc))
+        {
+            return ExportFrameFolder(argv[i + 1], argv[i + 2], (i + 3 < argc) ? atoi(argv[i + 3]) : 0);
+        }
+        else if ((strcmp(argv[i], "--compact-sheet") == 0) && (i + 4 < argc))
+        {
+            const bool exported = ExportCompactSheet(argv[i + 1], atoi(argv[i + 2]), atoi(argv[i + 3]), argv[i + 4]);
+            return exported ? 0 : 1;
+        }
+        else if ((strcmp(argv[i], "--render") == 0) && (i + 8 < argc))
+        {
+            return RenderFrameToFile(argv[i + 1], atoi(argv[i + 2]), atoi(argv[i + 3]), atoi(argv[i + 4]), atoi(argv[i + 5]),
+                                     static_cast<float>(atof(argv[i + 6])), static_cast<float>(atof(argv[i + 7])), argv[i + 8]);
+        }
+        else if ((strcmp(argv[i], "--export-hitboxes") == 0) && (i + 4 < argc))
+        {
+            return ExportHitboxes(argv[i + 1], atoi(argv[i + 2]), atoi(argv[i + 3]), argv[i + 4]);
+        }
+        else if ((strcmp(argv[i], "--compare") == 0) && (i + 2 < argc))
+        {
+            return CompareImageFiles(argv[i + 1], argv[i + 2], (i + 3 < argc) ? atoi(argv[i + 3]) : 0);
+        }
+        else if ((strcmp(argv[i], "--daemon") == 0) && (i + 1 < argc)) return RunPreviewDaemon(argv[i + 1]);
+        else if ((strcmp(argv[i], "--preview") == 0) && (i + 9 < argc))
+        {
+            const PreviewRequest request = MakePreviewRequest(argv[i + 2], atoi(argv[i + 3]), atoi(argv[i + 4]), atoi(argv[i + 5]), atoi(argv[i + 6]),
+                                                              static_cast<float>(atof(argv[i + 7])), static_cast<float>(atof(argv[i + 8])));
+            return RunPreviewRequest(argv[i + 1], request, argv[i + 9]);
+        }
+    }
+
+    // Sheets that would take the viewer over budget are downsampled or refused, headless replays included
+    GetMemoryLedger().SetBudget(static_cast<size_t>(memoryBudgetMiB)*1024*1024);
+    GetMemoryLedger().SetPolicy(refuseOversize ? MemoryBudgetPolicy::Refuse : MemoryBudgetPolicy::Downsample);
+
+    if (headless)
+    {
+        if (allocCheckFrames > 0) return RunHeadlessAllocCheck(allocCheckFrames, allocCheckSheet, allocCheckColumns, allocCheckRows);
+
+        if (replayFileName == nullptr)
+        {
+            fprintf(stderr, "--headless needs a log to run: --replay <log> or --alloc-check <frames>\n");
+            return 1;
+        }
+
+        return RunHeadlessReplay(replayFileName, timingsFileName);
+    }
+
+    InputReplay replay;
+    bool replaying = (replayFileName != nullptr) && replay.Load(replayFileName);
+    FrameTimingReport replayReport;
+    float frameWorkMs = 0.0f;   // Last frame from the top of the loop to the pacer wait, what a replay reports
+
     InitWindow(screenWidth, screenHeight, "Sprite Viewer");
-    SetTargetFPS(60);
+
+    // raylib's own frame limiter only sleeps, which wakes up late by up to a timer period; the pacer takes over
+    SetTargetFPS(0);
+    FramePacer framePacer(targetFps);
+    FrameJitterStats jitter(framePacer.GetPeriodMs());
+    float targetRate = static_cast<float>(targetFps);
 
     // Custom file dialog
+    // Loads, decodes and directory listings run here, off the UI thread
+    JobSystem jobs;
+
     GuiWindowFileDialogState fileDialogState = InitGuiWindowFileDialog(GetWorkingDirectory());
+    fileDialogState.jobs = &jobs;
+
+    // Recursive fuzzy search over the whole asset tree
+    std::unique_ptr<GuiAssetSearchState> assetSearchState = std::make_unique<GuiAssetSearchState>();
+    InitGuiAssetSearch(assetSearchState.get(), GetWorkingDirectory());
 
     char fileNameToLoad[512] {0};
+    bool loadRequested = false;
     bool warningMessage = false;
+    std::string warningText;
+
+    // The file dialog picks a frame and its whole folder is imported
+    bool importFrames = false;
+    std::string sheetInfo;
 
     Vector2 pos {50, 100};
 
     int frameCol = 10;
     bool frameColDropdown = false;
-    const char* frameColOptions {"0;1;2;3;4;5;6;7;8;9;10;11;12;13;14;15;16;17;18;19;20"};
+    std::string frameColOptions = MakeCountOptions(20);
 
     int frameRow = 6;
     bool frameRowDropdown = false;
-    const char* frameRowOptions {"0;1;2;3;4;5;6;7;8;9;10;11;12;13;14;15;16;17;18;19;20"};
+    std::string frameRowOptions = MakeCountOptions(20);
 
     float frameFacing = 1.0f;
 
@@ -101,78 +702,401 @@ int main()
 
     int selectedRow = 0;
     bool rowDropdown = false;
-    const char* rowOptions {"Row 1;Row 2;Row 3;Row 4;Row 5;Row 6;Row 7;Row 8"};
+    const char* defaultRowOptions {"Row 1;Row 2;Row 3;Row 4;Row 5;Row 6;Row 7;Row 8"};
+    std::string rowOptions = defaultRowOptions;
 
     int selectedAdvanceMode = 0;
     bool advanceMode = false;
     const char* advanceModeOptions {"False;True"};
 
+    bool compactFrames = false;
+    bool premultiplyAlpha = false;
+    bool showHitboxes = false;
+
+    // Neighbour frames ghosted behind the current one
+    bool showOnionSkin = false;
+    float onionFrames = 2.0f;
+    float onionOpacity = 0.5f;
+    OnionSkinSettings onionSettings;
+    OnionSkin onionSkin;
+
+    int packMode = 0;
+    bool packModeDropdown = false;
+    const char* packModeOptions {"RGBA8888;Auto;RGBA4444;RGBA5551;RGB565"};
+    float packTolerance = 0.0f;
+
     std::unique_ptr<Sprite> sprite {nullptr};
 
-    bool hasAdvancedRow = false;
+    // Animation runs on its own thread, UI changes go in as commands and frames come back as snapshots.
+    // A replay steps it once per frame instead, like a headless one, so results do not depend on timing
+    Simulation simulation(replaying ? replay.GetTickRate() : 60);
+    if (!replaying) simulation.Start();
+
+    std::unique_ptr<InputRecorder> recorder {nullptr};
+    if (recordFileName != nullptr) recorder = std::make_unique<InputRecorder>(simulation.GetTickRate());
+
+    unsigned int frameIndex = 0;
+
+    ImagePrefetcher prefetcher(jobs);
+
+    // The newest load request, and the finished load waiting to be applied
+    unsigned int loadVersion = 0;
+    CancelToken loadCancel;
+    JobCounter loadJobs;
+    std::shared_ptr<SheetLoad> finishedLoad;
+    bool loading = false;
+
+    int debugPanel = 0;     // Frame pacing, job system or memory
+    float budgetMiB = static_cast<float>(memoryBudgetMiB);
+    int prefetchFocus = -1;
+    unsigned int prefetchListing = 0;   // Listing the prefetch was requested from, 0 for none
+
+    unsigned int sheetVersion = 0;
+    unsigned int rowVersion = 0;
+    int sentRow = selectedRow;
+    SpriteParams sentParams {};
+
+    float renderMs = 0.0f;
+
+    // Main thread allocations per phase of the frame, shown in the UI
+    AllocFrameProfile allocProfile;
+    unsigned int allocFrames = 0;       // Frames that allocated, counted by --alloc-check
+    unsigned int allocFirstFrame = 0;
+
+    if (allocCheckSheet != nullptr)
+    {
+        strncpy(fileNameToLoad, allocCheckSheet, sizeof(fileNameToLoad) - 1);
+        frameCol = allocCheckColumns;
+        frameRow = allocCheckRows;
+        loadRequested = true;
+    }
 
     unsigned int currentTime = 0;
     
     while (!WindowShouldClose())
     {
-        currentTime = (unsigned int)GetTime();
+        const double frameStart = GetTime();
+        currentTime = (unsigned int)frameStart;
 
-        if (sprite != nullptr)
+        if (recorder != nullptr) recorder->RecordInput(frameIndex, CaptureInputState());
+
+        // Recorded UI changes are applied as if they had been made through the widgets
+        if (replaying)
         {
-            if ((sprite->GetCurrentFrame() + 1) >= totalFrames && !hasAdvancedRow)
+            ReplayEvent event;
+            while (replay.Next(frameIndex, event))
             {
-                selectedRow = selectedRow + 1;
-                hasAdvancedRow = true;
-            }
-            else if (sprite->GetCurrentFrame() < totalFrames && selectedRow == frameRow)
-            {
-                selectedRow = 0;
-                hasAdvancedRow = false;
+                switch (event.type)
+                {
+                    case ReplayEventType::Params:
+                    {
+                        pos = event.params.position;
+                        frameScale = event.params.frameScale;
+                        frameSpeed = event.params.frameSpeed;
+                        frameFacing = event.params.frameFacing;
+                        totalFrames = event.params.totalFrames;
+                        selectedAdvanceMode = event.params.advanceRow ? 1 : 0;
+                    } break;
+                    case ReplayEventType::Row: selectedRow = event.selectedRow; break;
+                    case ReplayEventType::LoadSheet:
+                    {
+                        frameCol = event.frameColumns;
+                        frameRow = event.frameRows;
+                        compactFrames = event.loadOptions.compactDuplicates;
+                        premultiplyAlpha = event.loadOptions.premultiplyAlpha;
+                        packMode = event.loadOptions.packMode;
+                        packTolerance = static_cast<float>(event.loadOptions.packTolerance);
+                        strcpy(fileNameToLoad, event.path);
+                        loadRequested = true;
+                    } break;
+                    case ReplayEventType::ClearSheet:
+                    {
+                        // A load still running would bring the sheet back
+                        loadCancel.Cancel();
+                        ++loadVersion;
+                        loading = false;
+
+                        sprite.reset();
+                        simulation.Submit(SimCommand::Clear(0, ++sheetVersion));
+                    } break;
+                    default: break;
+                }
             }
-            else if (sprite->GetCurrentFrame() < totalFrames)
+
+            // The frame's own work, GetFrameTime() would only show the pacer's interval
+            if (frameIndex > 0) replayReport.Add(frameWorkMs);
+
+            if (replay.IsFinished(frameIndex))
             {
-                hasAdvancedRow = false;
+                printf("Replay: %s\n", replayFileName);
+                replayReport.Print(stdout);
+                if (timingsFileName != nullptr) replayReport.SaveCsv(timingsFileName);
+                replaying = false;
+                simulation.Start();
             }
+        }
+
+        allocProfile.Enter(AllocPhase::Sync);
+
+        // Commands sent last frame are applied by this tick
+        if (replaying) simulation.Tick();
+
+        const SimSnapshot& simSnapshot = simulation.Acquire();
+        const SimSpriteState& spriteState = simSnapshot.sprites[0];
+
+        // Rows picked in the UI go to the simulation, otherwise follow its automatic row advance
+        if (selectedRow != sentRow)
+        {
+            simulation.Submit(SimCommand::Row(0, ++rowVersion, selectedRow));
+            sentRow = selectedRow;
+
+            if (recorder != nullptr) recorder->RecordRow(frameIndex, selectedRow);
+        }
+        else if (spriteState.rowVersion == rowVersion)
+        {
+            selectedRow = sentRow = spriteState.selectedRow;
+        }
+
+        const SpriteParams params {pos, frameScale, frameSpeed, frameFacing, totalFrames, static_cast<bool>(selectedAdvanceMode)};
+        if (params != sentParams && simulation.Submit(SimCommand::Params(0, params)))
+        {
+            sentParams = params;
 
-            sprite->Update(pos, frameScale, frameSpeed, selectedRow, frameFacing, totalFrames, static_cast<bool>(selectedAdvanceMode));
+            if (recorder != nullptr) recorder->RecordParams(frameIndex, params);
         }
 
+        allocProfile.Enter(AllocPhase::Load);
+
+        // Texture uploads of finished loads and directory listings for the file dialog
+        jobs.RunMainContinuations(MAIN_CONTINUATION_BUDGET_MS);
+        jobs.Sample();
+
         if (fileDialogState.SelectFilePressed)
         {
+            // Directory paths can be longer than the load path, those are refused rather than cut short
+            if (importFrames)
+            {
+                if (snprintf(fileNameToLoad, sizeof(fileNameToLoad), "%s", fileDialogState.dirPathText) < static_cast<int>(sizeof(fileNameToLoad))) loadRequested = true;
+                else
+                {
+                    fileNameToLoad[0] = '\0';
+                    warningText = "The path of the folder is too long.";
+                    warningMessage = true;
+                }
+                importFrames = false;
+            }
             // Load file (if supported extension)
-            if (IsFileExtension(fileDialogState.fileNameText, ".png"))
+            else if (IsFileExtension(fileDialogState.fileNameText, ".png;.ase;.aseprite;.json"))
             {
-                strcpy(fileNameToLoad, TextFormat("%s" PATH_SEPERATOR "%s", fileDialogState.dirPathText, fileDialogState.fileNameText));
-                
-                sprite.reset();
-                sprite = std::make_unique<Sprite>(pos, fileNameToLoad, frameCol, frameRow, frameFacing);
+                if (snprintf(fileNameToLoad, sizeof(fileNameToLoad), "%s" PATH_SEPERATOR "%s", fileDialogState.dirPathText, fileDialogState.fileNameText) < static_cast<int>(sizeof(fileNameToLoad))) loadRequested = true;
+                else
+                {
+                    fileNameToLoad[0] = '\0';
+                    warningText = "The path of the file is too long.";
+                    warningMessage = true;
+                }
             }
             else
             {
+                warningText = "The file should be a .png, .ase or .json file.";
                 warningMessage = true;
             }
 
             fileDialogState.SelectFilePressed = false;
         }
 
+        UpdateGuiAssetSearch(assetSearchState.get());
+
+        if (assetSearchState->OpenPressed)
+        {
+            // Deep asset trees can outgrow the load path
+            if (snprintf(fileNameToLoad, sizeof(fileNameToLoad), "%s", assetSearchState->selectedPath) < static_cast<int>(sizeof(fileNameToLoad))) loadRequested = true;
+            else
+            {
+                fileNameToLoad[0] = '\0';
+                warningText = "The path of the file is too long.";
+                warningMessage = true;
+            }
+
+            assetSearchState->OpenPressed = false;
+        }
+
+        // Decode the highlighted file and its neighbours while the user is still browsing
+        if (fileDialogState.windowActive && (fileDialogState.dirFiles.paths != nullptr))
+        {
+            const int focused = (fileDialogState.itemFocused >= 0) ? fileDialogState.itemFocused : fileDialogState.filesListActive;
+
+            // Keyed on the listing version, a new listing can land at the address of the old one
+            if ((focused != prefetchFocus) || (fileDialogState.listingShown != prefetchListing))
+            {
+                if (focused >= 0) RequestPrefetch(prefetcher, fileDialogState.dirFiles, focused);
+                prefetchFocus = focused;
+                prefetchListing = fileDialogState.listingShown;
+            }
+        }
+        else if (prefetchListing != 0)
+        {
+            prefetcher.Cancel();
+            prefetchFocus = -1;
+            prefetchListing = 0;
+        }
+
+        if (loadRequested)
+        {
+            // The current sheet stays up until the new one is ready, a load still running is dropped
+            loadCancel.Cancel();
+            loadCancel = CancelToken();
+
+            std::shared_ptr<SheetLoad> load = std::make_shared<SheetLoad>();
+            load->version = ++loadVersion;
+            load->path = fileNameToLoad;
+            load->ownGrid = HasOwnGrid(fileNameToLoad);
+            load->columns = frameCol;
+            load->rows = frameRow;
+            load->position = pos;
+            load->facing = frameFacing;
+            load->options.compactDuplicates = compactFrames;
+            load->options.premultiplyAlpha = premultiplyAlpha;
+            load->options.packMode = static_cast<PixelPackMode>(packMode);
+            load->options.packTolerance = static_cast<int>(packTolerance);
+            load->replacedBytes = (sprite != nullptr) ? sprite->GetMemory().GetTotalBytes() : 0;
+
+            const CancelToken cancel = loadCancel;
+            jobs.Submit(JobPriority::Interactive, [load, cancel, &jobs, &prefetcher, &finishedLoad, &loadVersion]()
+            {
+                RunSheetLoad(*load, prefetcher, cancel);
+                if (cancel.IsCancelled()) return;
+
+                // Textures can only be created on the thread that owns the GL context
+                jobs.PostMain([load, &finishedLoad, &loadVersion]()
+                {
+                    if (load->version != loadVersion) return;
+                    if (load->sprite != nullptr) load->sprite->UploadTexture();
+                    finishedLoad = load;
+                });
+            }, loadCancel, &loadJobs);
+
+            if (recorder != nullptr)
+            {
+                const ReplayLoadOptions recordedOptions{ compactFrames, premultiplyAlpha, static_cast<unsigned char>(packMode), static_cast<int>(packTolerance) };
+                recorder->RecordLoadSheet(frameIndex, fileNameToLoad, frameCol, frameRow, recordedOptions);
+            }
+
+            loading = true;
+            loadRequested = false;
+
+            // Replays land the sheet on the frame it was asked for, however long decoding takes
+            if (replaying)
+            {
+                loadJobs.Wait();
+                while ((finishedLoad == nullptr) && (jobs.GetMainQueued() > 0)) jobs.RunMainContinuations(MAIN_CONTINUATION_BUDGET_MS);
+            }
+        }
+
+        if (finishedLoad != nullptr)
+        {
+            SheetLoad& load = *finishedLoad;
+
+            if (!load.error.empty())
+            {
+                warningText = load.error;
+                warningMessage = true;
+            }
+            // A grid changed while loading means the sheet needs cutting up again, the dropdowns already dropped it
+            else if (load.ownGrid || ((load.columns == frameCol) && (load.rows == frameRow)))
+            {
+                // The grid comes from the source, the dropdowns grow to show it if needed
+                if (load.ownGrid)
+                {
+                    frameCol = load.columns;
+                    frameRow = load.rows;
+                    if (frameCol > 20) frameColOptions = MakeCountOptions(frameCol);
+                    if (frameRow > 20) frameRowOptions = MakeCountOptions(frameRow);
+                }
+
+                sprite = std::move(load.sprite);
+                onionSkin.Invalidate();
+                sheetInfo = load.info;
+                if (load.admission.result == MemoryAdmission::Downsampled)
+                {
+                    sheetInfo += TextFormat("%sShrunk 1/%d to fit the memory budget", sheetInfo.empty() ? "" : " | ", load.admission.shrink);
+                }
+
+                // With tags the row dropdown picks the animation instead
+                const FrameTable* frameTable = sprite->GetFrameTable().get();
+                const std::string newRowOptions = ((frameTable != nullptr) && (frameTable->GetTagCount() > 0)) ? MakeTagOptions(*frameTable) : defaultRowOptions;
+                if (newRowOptions != rowOptions)
+                {
+                    rowOptions = newRowOptions;
+                    selectedRow = 0;
+                }
+
+                simulation.Submit(SimCommand::Sheet(0, ++sheetVersion, sprite->GetSheetWidth(), sprite->GetSheetHeight(), frameCol, frameRow, sprite->GetFrameTable()));
+            }
+
+            finishedLoad.reset();
+            loading = false;
+        }
+
+        // Only draw simulation output that belongs to the currently loaded sheet
+        const bool spriteSynced = (sprite != nullptr) && spriteState.active && (spriteState.sheetVersion == sheetVersion);
+
+        // Redrawn only when the frame, row, scale or facing moved on, drawing it is one quad either way
+        const bool onionSkinShown = showOnionSkin && spriteSynced;
+        if (onionSkinShown)
+        {
+            onionSettings.before = onionSettings.after = static_cast<int>(onionFrames);
+            onionSettings.opacity = onionOpacity;
+            onionSkin.Update(*sprite, spriteState.frame, spriteState.selectedRow, selectedAdvanceMode ? frameCol : totalFrames, onionSettings);
+        }
+
+        if (IsKeyPressed(KEY_F12)) SaveBackendComparison(sprite.get(), spriteSynced ? &spriteState.frame : nullptr);
+
+        const double renderStart = GetTime();
+        allocProfile.Enter(AllocPhase::Scene);
+
         BeginDrawing();
         ClearBackground(WHITE);
         DrawFPS(10, 10);
+        DrawText(TextFormat("Sim: %d Hz, tick %.3f ms | Render: %.2f ms | Prefetch: %u hits, %u misses",
+                            simulation.GetTickRate(), simSnapshot.tickMs, renderMs, prefetcher.GetHits(), prefetcher.GetMisses()), 180, 14, 10, DARKGRAY);
         DrawText("Current Time: ", 460, 80, 18, BLACK);
-        DrawText(std::to_string(currentTime).c_str(), 580, 80, 18, BLACK);
-        const Vector2 texturePos {screenWidth - 565, screenHeight - 350};
-        DrawTexturePreview(texturePos, sprite.get(), 560, 340);
+        DrawText(TextFormat("%u", currentTime), 580, 80, 18, BLACK);
+        GpuCanvas canvas;
+        DrawScene(canvas, sprite.get(), spriteSynced ? &spriteState.frame : nullptr, onionSkinShown ? &onionSkin : nullptr);
 
-        int gridWidth = 480;
-        int gridHeight = 480;
+        if (showHitboxes && spriteSynced) DrawHitboxes(*sprite, spriteState.frame);
 
-        DrawGrid(20, 70, gridWidth, gridHeight);
+        allocProfile.Enter(AllocPhase::Ui);
 
-        if (sprite != nullptr)
+        // Pixel under the mouse, from the frame's opacity mask
+        DrawText("Hitboxes", 500, 42, 10, BLACK);
+        GuiCheckBox((Rectangle){ 480, 40, 15, 15 }, nullptr, &showHitboxes);
+
+        DrawText("Onion Skin", 500, 59, 10, BLACK);
+        GuiCheckBox((Rectangle){ 480, 57, 15, 15 }, nullptr, &showOnionSkin);
+        GuiSliderBar((Rectangle){ 610, 58, 60, 12 }, "Ghosts", TextFormat("%d", static_cast<int>(onionFrames)), &onionFrames, 1.0f, ONION_SKIN_MAX_GHOSTS);
+        GuiSliderBar((Rectangle){ 740, 58, 60, 12 }, "Opacity", TextFormat("%.2f", onionOpacity), &onionOpacity, 0.1f, 1.0f);
+        if (onionSkinShown)
+        {
+            DrawText(TextFormat("Rebuilt %u (%.2f ms)", onionSkin.GetRebuilds(), onionSkin.GetRebuildMs()), 830, 59, 10, DARKGRAY);
+        }
+
+        int pickX = 0, pickY = 0;
+        if (spriteSynced && sprite->PickPixel(spriteState.frame, GetMousePosition(), &pickX, &pickY))
         {
-            sprite->Draw();
+            DrawText(TextFormat("Frame %d pixel %d, %d", sprite->GetMaskIndex(spriteState.frame), pickX, pickY), 560, 42, 10, DARKGREEN);
         }
 
+        // Last frame's heap allocations, the steady state should show none
+        const AllocCount frameAllocs = allocProfile.GetFrame();
+        DrawText(TextFormat("Allocs/frame: %llu (%llu B) | input %llu, sync %llu, load %llu, scene %llu, ui %llu, present %llu | other threads %llu | total %llu",
+                            frameAllocs.count, frameAllocs.bytes,
+                            allocProfile.GetPhase(AllocPhase::Input).count, allocProfile.GetPhase(AllocPhase::Sync).count,
+                            allocProfile.GetPhase(AllocPhase::Load).count, allocProfile.GetPhase(AllocPhase::Scene).count,
+                            allocProfile.GetPhase(AllocPhase::Ui).count, allocProfile.GetPhase(AllocPhase::Present).count,
+                            allocProfile.GetOtherThreads().count, GetProcessAllocCount().count), 180, 26, 10, DARKGRAY);
+
         const int uiLeft = screenWidth - 250;
         GuiGroupBox((Rectangle){uiLeft, 70, 242, 340}, "Sprite Settings");
 
@@ -194,6 +1118,48 @@ int main()
             6.0f
         );
 
+        if (loading) DrawText("Loading...", uiLeft + 10, 85 + 20*11, 9, DARKBLUE);
+        else if (!sheetInfo.empty()) DrawText(sheetInfo.c_str(), uiLeft + 10, 85 + 20*11, 9, DARKGRAY);
+
+        if (sprite != nullptr)
+        {
+            const PixelPipelineStats& pixelStats = sprite->GetPixelStats();
+
+            DrawText(TextFormat("Premultiply: %.2f GB/s (%s)", pixelStats.premultiplyGBs, pixelStats.kernel), uiLeft + 10, 85 + 20*12, 9, DARKGRAY);
+            DrawText(TextFormat("%s: %zu bytes saved, %.2f GB/s", GetPixelFormatName(pixelStats.format), pixelStats.bytesSaved, pixelStats.packGBs), uiLeft + 10, 85 + 20*13, 9, DARKGRAY);
+            DrawText(TextFormat("Frames: %d, unique: %d", sprite->GetFrameCount(), sprite->GetUniqueFrameCount()), uiLeft + 10, 85 + 20*14, 9, DARKGRAY);
+            DrawText(TextFormat("Duplicate bytes: %zu, texture saved: %zu", sprite->GetDuplicateBytes(), sprite->GetBytesSaved()), uiLeft + 10, 85 + 20*15, 9, DARKGRAY);
+        }
+
+        // Load options, applied to the next load. Drawn bottom-up so open dropdowns stay on top
+        GuiSliderBar(
+            (Rectangle){uiLeft + 84, 85 + 20*10, 100, 15},
+            "Tolerance",
+            TextFormat("%d", static_cast<int>(packTolerance)),
+            &packTolerance,
+            0.0f,
+            16.0f
+        );
+
+        DrawText("Texture Format", uiLeft + 10, 85 + 20*9, 9, BLACK);
+
+        if (GuiDropdownBox(
+                (Rectangle){uiLeft + 84, 85 + 20*9, 100, 15},
+                packModeOptions,
+                &packMode,
+                packModeDropdown
+            ))
+        {
+            packModeDropdown = !packModeDropdown;
+        }
+
+        DrawText("Premultiply", uiLeft + 10, 85 + 20*8, 9, BLACK);
+        GuiCheckBox((Rectangle){uiLeft + 84, 85 + 20*8, 15, 15}, nullptr, &premultiplyAlpha);
+
+        // Duplicates are only dropped from the uploaded texture
+        DrawText("Compact Frames", uiLeft + 10, 85 + 20*7, 9, BLACK);
+        GuiCheckBox((Rectangle){uiLeft + 84, 85 + 20*7, 15, 15}, nullptr, &compactFrames);
+
         // -------------------------------
         // Dropdown ----------------------
         // -------------------------------
@@ -214,12 +1180,19 @@ int main()
 
         if (GuiDropdownBox(
                 (Rectangle){uiLeft + 84, 85 + 20*5, 100, 15},
-                frameColOptions,
+                frameColOptions.c_str(),
                 &frameCol,
                 frameColDropdown
             ))
         {
+            // A load still running would bring the sheet back
+            loadCancel.Cancel();
+            ++loadVersion;
+            loading = false;
+
             sprite.reset();
+            simulation.Submit(SimCommand::Clear(0, ++sheetVersion));
+            if (recorder != nullptr) recorder->RecordClearSheet(frameIndex);
             frameColDropdown = !frameColDropdown;
         }
 
@@ -227,12 +1200,19 @@ int main()
 
         if (GuiDropdownBox(
                 (Rectangle){uiLeft + 84, 85 + 20*4, 100, 15},
-                frameRowOptions,
+                frameRowOptions.c_str(),
                 &frameRow,
                 frameRowDropdown
             ) && !frameColDropdown)
         {
+            // A load still running would bring the sheet back
+            loadCancel.Cancel();
+            ++loadVersion;
+            loading = false;
+
             sprite.reset();
+            simulation.Submit(SimCommand::Clear(0, ++sheetVersion));
+            if (recorder != nullptr) recorder->RecordClearSheet(frameIndex);
             frameRowDropdown = !frameRowDropdown;
         }
 
@@ -252,7 +1232,7 @@ int main()
 
         if (GuiDropdownBox(
                 (Rectangle){ uiLeft + 84, 80 + 20*2, 100, 20 },
-                rowOptions,
+                rowOptions.c_str(),
                 &selectedRow,
                 rowDropdown
             ))
@@ -260,18 +1240,74 @@ int main()
             rowDropdown = !rowDropdown;
         }
 
+        // Debug panel: frame pacing, or the job system's queues and workers
+        GuiGroupBox((Rectangle){ 20, 565, 430, 195 }, nullptr);
+        GuiToggleGroup((Rectangle){ 28, 558, 80, 14 }, "Frame Pacing;Jobs;Memory", &debugPanel);
+
+        if (debugPanel == 0)
+        {
+            // Target rate, delta histogram and animation frames against their ideal timeline
+            GuiSliderBar(
+                (Rectangle){ 100, 575, 200, 15 },
+                "Target Rate",
+                (static_cast<int>(targetRate) > 0) ? TextFormat("%d Hz", static_cast<int>(targetRate)) : "Unpaced",
+                &targetRate,
+                0.0f,
+                240.0f
+            );
+
+            const bool jitterReset = GuiButton((Rectangle){ 380, 575, 60, 15 }, "Reset");
+            if (jitterReset || (static_cast<int>(targetRate) != static_cast<int>(framePacer.GetTargetRate())))
+            {
+                framePacer.SetTargetRate(static_cast<int>(targetRate));
+                jitter.Reset((framePacer.GetTargetRate() > 0.0) ? framePacer.GetPeriodMs() : 1000.0/60.0);
+            }
+
+            DrawJitterPanel(jitter, framePacer, (Rectangle){ 30, 597, 410, 158 });
+        }
+        else if (debugPanel == 1) DrawJobPanel(jobs, (Rectangle){ 30, 577, 410, 178 });
+        else
+        {
+            // Budget for sheet loads, 0 for none, and what happens to a sheet over it
+            GuiSliderBar(
+                (Rectangle){ 100, 575, 200, 15 },
+                "Budget",
+                (static_cast<int>(budgetMiB) > 0) ? TextFormat("%d MiB", static_cast<int>(budgetMiB)) : "Unlimited",
+                &budgetMiB,
+                0.0f,
+                2048.0f
+            );
+            GuiCheckBox((Rectangle){ 380, 576, 12, 12 }, "Refuse", &refuseOversize);
+
+            GetMemoryLedger().SetBudget(static_cast<size_t>(budgetMiB)*1024*1024);
+            GetMemoryLedger().SetPolicy(refuseOversize ? MemoryBudgetPolicy::Refuse : MemoryBudgetPolicy::Downsample);
+
+            DrawMemoryPanel(GetMemoryLedger(), sprite.get(), (Rectangle){ 30, 597, 410, 158 });
+        }
+
         //----------------------------------------------------------------
-        if (fileDialogState.windowActive)
+        if (fileDialogState.windowActive || assetSearchState->windowActive)
         {
             GuiLock();
         }
         if (GuiButton((Rectangle){ 20, 35, 140, 30 }, GuiIconText(ICON_FILE_OPEN, "Load Sprite")))
         {
+            importFrames = false;
             fileDialogState.windowActive = true;
         }
+        if (GuiButton((Rectangle){ 320, 35, 140, 30 }, GuiIconText(ICON_FOLDER_OPEN, "Import Frames")))
+        {
+            importFrames = true;
+            fileDialogState.windowActive = true;
+        }
+        if (GuiButton((Rectangle){ 170, 35, 140, 30 }, "#42#Find Asset"))
+        {
+            assetSearchState->windowActive = true;
+        }
 
         GuiUnlock();
         GuiWindowFileDialog(&fileDialogState);
+        GuiAssetSearch(assetSearchState.get());
 
         //----------------------------------------------------------------
         if (warningMessage)
@@ -279,7 +1315,7 @@ int main()
             int result = GuiMessageBox(
                 (Rectangle){ screenWidth/2 - 100, screenHeight/2 - 100, 250, 100 },
                     "#191#Message Box", 
-                    "The file should be a .png file.", 
+                    warningText.c_str(),
                     "OK"
             );
             
@@ -289,8 +1325,61 @@ int main()
             }
         }
 
+        renderMs = static_cast<float>((GetTime() - renderStart)*1000.0);
+
+        allocProfile.Enter(AllocPhase::Present);
         EndDrawing();
+        allocProfile.EndFrame();
+
+        // Measured at the swap, where the viewer sees it, then wait out the rest of the interval
+        const double presentMs = GetTime()*1000.0;
+        frameWorkMs = static_cast<float>(presentMs - frameStart*1000.0);
+        jitter.AddPresent(presentMs);
+        if (spriteSynced) jitter.AddAnimationFrame(spriteState.frame.frameStep, spriteState.frame.frameMs, presentMs);
+        else jitter.ClearAnimationFrame();
+
+        framePacer.Wait();
+
+        if (allocCheckFrames > 0)
+        {
+            // The simulation, job workers and prefetcher count too, an idle viewer means all of it
+            const AllocCount allocs = allocProfile.GetFrame();
+            const AllocCount others = allocProfile.GetOtherThreads();
+            if ((frameIndex >= ALLOC_CHECK_WARMUP) && ((allocs.count > 0) || (others.count > 0)))
+            {
+                if (allocFrames++ == 0) allocFirstFrame = frameIndex;
+                TraceLog(LOG_WARNING, "ALLOC: frame %u made %llu allocations (%llu bytes), most in %s, and %llu on other threads", frameIndex,
+                         allocs.count, allocs.bytes, GetAllocPhaseName(allocProfile.GetWorstPhase()), others.count);
+            }
+
+            if (frameIndex + 1 >= ALLOC_CHECK_WARMUP + static_cast<unsigned int>(allocCheckFrames))
+            {
+                frameIndex++;
+                break;
+            }
+        }
+
+        frameIndex++;
     }
     
+    simulation.Stop();
+
+    // A load still running points at the prefetcher and the locals above
+    loadCancel.Cancel();
+    loadJobs.Wait();
+
+    if (allocCheckFrames > 0)
+    {
+        if (allocFrames == 0) printf("Allocation check: no allocations in %d idle frames\n", allocCheckFrames);
+        else printf("Allocation check: %u of %d idle frames allocated, first at frame %u\n", allocFrames, allocCheckFrames, allocFirstFrame);
+    }
+
+    if ((recorder != nullptr) && !recorder->Save(recordFileName, frameIndex))
+    {
+        TraceLog(LOG_WARNING, "Could not write input log: %s", recordFileName);
+    }
+
     CloseWindow();
+
+    return ((allocCheckFrames > 0) && (allocFrames > 0)) ? 1 : 0;
 }
\ No newline at end of file
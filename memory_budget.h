@@ -0,0 +1,298 @@
+#pragma once
+
+#include "raylib.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// CPU and GPU memory the viewer holds, by owner, and the budget new sheets have to fit in.
+// Owners report what they hold through a MemoryCharge; the ledger only adds the numbers up
+
+// Who holds the memory
+enum class MemoryPool
+{
+    Sheet = 0,      // Loaded sheets: texture, prepared image, CPU copy, masks and tables
+    Prefetch,       // Images decoded ahead of a load
+    OnionSkin,      // Ghost frame render texture
+    FileDialog,     // Directory listing and icon buffers
+    Count
+};
+
+inline const char* GetMemoryPoolName(MemoryPool pool)
+{
+    static const char* names[] = { "Sheets", "Prefetch", "Onion skin", "File dialog" };
+    return names[static_cast<int>(pool)];
+}
+
+// What happens to a sheet that does not fit in the budget
+enum class MemoryBudgetPolicy
+{
+    Downsample = 0,     // Halve its cells until it fits, when its layout allows it
+    Refuse
+};
+
+enum class MemoryAdmission
+{
+    Fits = 0,
+    Downsampled,
+    Refused
+};
+
+inline double BytesToMiB(size_t bytes)
+{
+    return bytes/(1024.0*1024.0);
+}
+
+// Memory of one loaded sheet
+struct SheetMemory
+{
+    size_t decodedBytes;    // Prepared image waiting for its upload
+    size_t textureBytes;    // GPU
+    size_t softBytes;       // RGBA copy for SoftCanvas
+    size_t maskBytes;       // Opacity masks and hitboxes
+    size_t tableBytes;      // Cell remap and frame table
+
+    size_t GetCpuBytes() const
+    {
+        return decodedBytes + softBytes + maskBytes + tableBytes;
+    }
+
+    size_t GetTotalBytes() const
+    {
+        return GetCpuBytes() + textureBytes;
+    }
+};
+
+// What a sheet of this size keeps once uploaded, before compaction or packing shrink its texture
+inline SheetMemory EstimateSheetMemory(int width, int height, bool keepSoftTexture)
+{
+    const size_t pixels = static_cast<size_t>(std::max(width, 0))*static_cast<size_t>(std::max(height, 0));
+
+    SheetMemory memory = { 0, 0, 0, 0, 0 };
+    memory.textureBytes = pixels*4;
+    memory.softBytes = keepSoftTexture ? pixels*4 : 0;
+    memory.maskBytes = pixels/8;
+    return memory;
+}
+
+// Totals of every pool, safe to update from any thread. Static storage is zeroed before anything runs,
+// so owners with static storage can report from their constructors and destructors
+class MemoryLedger
+{
+private:
+    static const int poolCount = static_cast<int>(MemoryPool::Count);
+
+    std::atomic<long long> cpuBytes[poolCount];
+    std::atomic<long long> gpuBytes[poolCount];
+    std::atomic<long long> peakBytes;
+
+    std::atomic<long long> budgetBytes;     // 0 is unlimited
+    std::atomic<int> policy;
+
+    std::atomic<unsigned int> downsampled;
+    std::atomic<unsigned int> refused;
+
+    static size_t Clamp(long long bytes)
+    {
+        return (bytes > 0) ? static_cast<size_t>(bytes) : 0;
+    }
+
+public:
+    // Negative sizes release
+    void Add(MemoryPool pool, long long cpuBytes_, long long gpuBytes_)
+    {
+        cpuBytes[static_cast<int>(pool)].fetch_add(cpuBytes_, std::memory_order_relaxed);
+        gpuBytes[static_cast<int>(pool)].fetch_add(gpuBytes_, std::memory_order_relaxed);
+
+        const long long total = static_cast<long long>(GetTotalBytes());
+        long long peak = peakBytes.load(std::memory_order_relaxed);
+        while ((total > peak) && !peakBytes.compare_exchange_weak(peak, total, std::memory_order_relaxed)) {}
+    }
+
+    size_t GetCpuBytes(MemoryPool pool) const
+    {
+        return Clamp(cpuBytes[static_cast<int>(pool)].load(std::memory_order_relaxed));
+    }
+
+    size_t GetGpuBytes(MemoryPool pool) const
+    {
+        return Clamp(gpuBytes[static_cast<int>(pool)].load(std::memory_order_relaxed));
+    }
+
+    size_t GetCpuBytes() const
+    {
+        size_t total = 0;
+        for (int i = 0; i < poolCount; i++) total += GetCpuBytes(static_cast<MemoryPool>(i));
+        return total;
+    }
+
+    size_t GetGpuBytes() const
+    {
+        size_t total = 0;
+        for (int i = 0; i < poolCount; i++) total += GetGpuBytes(static_cast<MemoryPool>(i));
+        return total;
+    }
+
+    size_t GetTotalBytes() const
+    {
+        return GetCpuBytes() + GetGpuBytes();
+    }
+
+    size_t GetPeakBytes() const
+    {
+        return Clamp(peakBytes.load(std::memory_order_relaxed));
+    }
+
+    // CPU and GPU together, 0 for no limit
+    void SetBudget(size_t bytes)
+    {
+        budgetBytes.store(static_cast<long long>(bytes), std::memory_order_relaxed);
+    }
+
+    size_t GetBudget() const
+    {
+        return Clamp(budgetBytes.load(std::memory_order_relaxed));
+    }
+
+    void SetPolicy(MemoryBudgetPolicy policy_)
+    {
+        policy.store(static_cast<int>(policy_), std::memory_order_relaxed);
+    }
+
+    MemoryBudgetPolicy GetPolicy() const
+    {
+        return static_cast<MemoryBudgetPolicy>(policy.load(std::memory_order_relaxed));
+    }
+
+    // Room left for something new, counting releasedBytes as freed when it lands
+    size_t GetAvailable(size_t releasedBytes) const
+    {
+        const size_t budget = GetBudget();
+        if (budget == 0) return SIZE_MAX;
+
+        const size_t total = GetTotalBytes();
+        const size_t used = total - std::min(releasedBytes, total);
+        return (budget > used) ? budget - used : 0;
+    }
+
+    void CountAdmission(MemoryAdmission admission)
+    {
+        if (admission == MemoryAdmission::Downsampled) downsampled.fetch_add(1, std::memory_order_relaxed);
+        else if (admission == MemoryAdmission::Refused) refused.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    unsigned int GetDownsampled() const
+    {
+        return downsampled.load(std::memory_order_relaxed);
+    }
+
+    unsigned int GetRefused() const
+    {
+        return refused.load(std::memory_order_relaxed);
+    }
+};
+
+inline MemoryLedger& GetMemoryLedger()
+{
+    static MemoryLedger ledger;
+    return ledger;
+}
+
+// Bytes one owner holds in a pool, released with it
+class MemoryCharge
+{
+private:
+    MemoryPool pool;
+    size_t cpuBytes;
+    size_t gpuBytes;
+
+public:
+    explicit MemoryCharge(MemoryPool pool_) : pool(pool_), cpuBytes(0), gpuBytes(0)
+    {
+    }
+
+    ~MemoryCharge()
+    {
+        Set(0, 0);
+    }
+
+    MemoryCharge(const MemoryCharge&) = delete;
+    MemoryCharge& operator=(const MemoryCharge&) = delete;
+
+    // What the owner holds now
+    void Set(size_t cpuBytes_, size_t gpuBytes_)
+    {
+        if ((cpuBytes_ == cpuBytes) && (gpuBytes_ == gpuBytes)) return;
+
+        GetMemoryLedger().Add(pool, static_cast<long long>(cpuBytes_) - static_cast<long long>(cpuBytes),
+                              static_cast<long long>(gpuBytes_) - static_cast<long long>(gpuBytes));
+        cpuBytes = cpuBytes_;
+        gpuBytes = gpuBytes_;
+    }
+
+    size_t GetCpuBytes() const
+    {
+        return cpuBytes;
+    }
+
+    size_t GetGpuBytes() const
+    {
+        return gpuBytes;
+    }
+
+    size_t GetTotalBytes() const
+    {
+        return cpuBytes + gpuBytes;
+    }
+};
+
+// How a decoded sheet was fitted into the budget
+struct SheetAdmission
+{
+    MemoryAdmission result;
+    size_t neededBytes;     // Estimated for the sheet as decoded
+    size_t availableBytes;
+    int shrink;             // Cells were divided by this in each direction
+};
+
+// Fit a decoded sheet into availableBytes: as it is, with its cells halved until it fits, or not at all.
+// Only a plain grid can be resampled, a frame table's rectangles would no longer match the pixels.
+// Runs on job workers, so it only uses raylib's image functions
+inline SheetAdmission AdmitSheet(Image* image, int columns, int rows, bool resampleable, bool keepSoftTexture,
+                                 size_t availableBytes, MemoryBudgetPolicy policy)
+{
+    SheetAdmission admission = { MemoryAdmission::Fits, 0, availableBytes, 1 };
+
+    // Nothing decoded, nothing to admit
+    if (image->data == nullptr)
+    {
+        admission.result = MemoryAdmission::Refused;
+        return admission;
+    }
+
+    admission.neededBytes = EstimateSheetMemory(image->width, image->height, keepSoftTexture).GetTotalBytes();
+    if (admission.neededBytes <= availableBytes) return admission;
+
+    admission.result = MemoryAdmission::Refused;
+    if ((policy == MemoryBudgetPolicy::Refuse) || !resampleable || (columns <= 0) || (rows <= 0)) return admission;
+
+    int cellWidth = image->width/columns;
+    int cellHeight = image->height/rows;
+    if ((cellWidth <= 0) || (cellHeight <= 0)) return admission;
+
+    while (EstimateSheetMemory(cellWidth*columns, cellHeight*rows, keepSoftTexture).GetTotalBytes() > availableBytes)
+    {
+        if ((cellWidth <= 1) && (cellHeight <= 1)) return admission;
+
+        cellWidth = std::max(cellWidth/2, 1);
+        cellHeight = std::max(cellHeight/2, 1);
+        admission.shrink *= 2;
+    }
+
+    // Nearest neighbour keeps pixel art crisp and each cell's pixels inside its cell
+    ImageResizeNN(image, cellWidth*columns, cellHeight*rows);
+    admission.result = MemoryAdmission::Downsampled;
+    return admission;
+}
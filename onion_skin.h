@@ -0,0 +1,240 @@
+#pragma once
+
+#include "raylib.h"
+#include "rlgl.h"
+#include "sprite.h"
+#include "soft_render.h"
+#include "memory_budget.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#define ONION_SKIN_MAX_GHOSTS 4     // Frames on each side of the current one
+
+// Which neighbour frames are ghosted behind the current one, and how
+struct OnionSkinSettings
+{
+    int before = 2;
+    int after = 2;
+    float opacity = 0.5f;                       // Of the nearest ghosts, farther ones fade out
+    Color beforeTint = { 255, 96, 96, 255 };
+    Color afterTint = { 96, 176, 255, 255 };
+};
+
+inline bool operator==(const OnionSkinSettings& a, const OnionSkinSettings& b)
+{
+    return (a.before == b.before) && (a.after == b.after) && (a.opacity == b.opacity) &&
+           (a.beforeTint.r == b.beforeTint.r) && (a.beforeTint.g == b.beforeTint.g) && (a.beforeTint.b == b.beforeTint.b) && (a.beforeTint.a == b.beforeTint.a) &&
+           (a.afterTint.r == b.afterTint.r) && (a.afterTint.g == b.afterTint.g) && (a.afterTint.b == b.afterTint.b) && (a.afterTint.a == b.afterTint.a);
+}
+
+// Neighbour frames of a sprite, tinted and composed into a render texture. The texture is only redrawn when
+// the frame, row, scale, facing or settings change, so showing it costs one quad however many ghosts it holds
+class OnionSkin
+{
+private:
+    RenderTexture2D target;
+    Rectangle bounds;           // Area the ghosts cover, relative to the sprite's position
+    int ghostCount;
+
+    // What the texture currently shows
+    bool valid;
+    const Sprite* shownSprite;
+    unsigned int shownSheet;
+    Rectangle shownFrameRec;
+    int shownFrame;
+    float shownScale;
+    float shownFacing;
+    int shownTag;
+    int shownRowFrames;
+    OnionSkinSettings shownSettings;
+
+    unsigned int rebuilds;
+    double rebuildMs;
+
+    MemoryCharge memoryCharge;
+
+    bool Shows(const Sprite& sprite, const SpriteSnapshot& snapshot, int tag_, int rowFrames_, const OnionSkinSettings& settings_) const
+    {
+        return valid && (shownSprite == &sprite) && (shownSheet == sprite.GetTexture().id) &&
+               (shownFrameRec.x == snapshot.frameRec.x) && (shownFrameRec.y == snapshot.frameRec.y) &&
+               (shownFrameRec.width == snapshot.frameRec.width) && (shownFrameRec.height == snapshot.frameRec.height) &&
+               (shownFrame == snapshot.currentFrame) && (shownScale == snapshot.frameScale) && (shownFacing == snapshot.frameFacing) &&
+               (shownTag == tag_) && (shownRowFrames == rowFrames_) && (shownSettings == settings_);
+    }
+
+    void Rebuild(const Sprite& sprite, const SpriteSnapshot& snapshot, int tag_, int rowFrames_, const OnionSkinSettings& settings)
+    {
+        SpriteSnapshot ghosts[2*ONION_SKIN_MAX_GHOSTS];
+        Color tints[2*ONION_SKIN_MAX_GHOSTS];
+        ghostCount = 0;
+
+        const int before = std::min(std::max(settings.before, 0), ONION_SKIN_MAX_GHOSTS);
+        const int after = std::min(std::max(settings.after, 0), ONION_SKIN_MAX_GHOSTS);
+        const int farthest = std::max(before, after);
+
+        SpriteSnapshot origin = snapshot;
+        origin.position = Vector2{ 0, 0 };
+
+        // Farthest first, so nearer ghosts land on top
+        for (int distance = farthest; distance >= 1; distance--)
+        {
+            const float fade = settings.opacity*(1.0f - static_cast<float>(distance - 1)/(farthest + 1));
+
+            for (int side = 0; side < 2; side++)
+            {
+                if (distance > ((side == 0) ? before : after)) continue;
+
+                const SpriteSnapshot ghost = sprite.GetNeighbourSnapshot(origin, (side == 0) ? -distance : distance, tag_, rowFrames_);
+
+                // Short rows wrap back onto the current frame, which is drawn anyway
+                if (ghost.currentFrame == snapshot.currentFrame) continue;
+
+                Color tint = (side == 0) ? settings.beforeTint : settings.afterTint;
+                tint.a = static_cast<unsigned char>(std::min(std::max(fade, 0.0f), 1.0f)*tint.a);
+
+                ghosts[ghostCount] = ghost;
+                tints[ghostCount] = tint;
+                ghostCount++;
+            }
+        }
+
+        if (ghostCount == 0) return;
+
+        Rectangle box = sprite.GetDrawnBox(ghosts[0]);
+        float right = box.x + box.width;
+        float bottom = box.y + box.height;
+        bounds = box;
+        for (int i = 1; i < ghostCount; i++)
+        {
+            box = sprite.GetDrawnBox(ghosts[i]);
+            bounds.x = std::min(bounds.x, box.x);
+            bounds.y = std::min(bounds.y, box.y);
+            right = std::max(right, box.x + box.width);
+            bottom = std::max(bottom, box.y + box.height);
+        }
+        bounds.x = std::floor(bounds.x);
+        bounds.y = std::floor(bounds.y);
+        bounds.width = std::ceil(right - bounds.x);
+        bounds.height = std::ceil(bottom - bounds.y);
+
+        // Grown, never shrunk, so stepping through frames of different sizes does not reallocate
+        const int width = static_cast<int>(bounds.width);
+        const int height = static_cast<int>(bounds.height);
+        if ((target.id == 0) || (target.texture.width < width) || (target.texture.height < height))
+        {
+            const int targetWidth = std::max(width, target.texture.width);
+            const int targetHeight = std::max(height, target.texture.height);
+            if (target.id != 0) UnloadRenderTexture(target);
+            target = LoadRenderTexture(targetWidth, targetHeight);
+
+            // RGBA8 colour and a depth buffer, which drivers store in 32 bits
+            memoryCharge.Set(0, static_cast<size_t>(targetWidth)*targetHeight*8);
+        }
+
+        GpuCanvas canvas;
+        BeginTextureMode(target);
+        ClearBackground(BLANK);
+
+        // The texture is composed premultiplied. Straight alpha sheets blend their colours as usual but
+        // accumulate coverage like premultiplied ones, so the alpha channel is not squared
+        const bool straight = !sprite.IsPremultiplied();
+        if (straight)
+        {
+            rlSetBlendFactorsSeparate(RL_SRC_ALPHA, RL_ONE_MINUS_SRC_ALPHA, RL_ONE, RL_ONE_MINUS_SRC_ALPHA, RL_FUNC_ADD, RL_FUNC_ADD);
+            BeginBlendMode(BLEND_CUSTOM_SEPARATE);
+        }
+
+        for (int i = 0; i < ghostCount; i++)
+        {
+            ghosts[i].position = Vector2{ -bounds.x, -bounds.y };
+            sprite.Draw(canvas, ghosts[i], tints[i]);
+        }
+
+        if (straight) EndBlendMode();
+        EndTextureMode();
+    }
+
+public:
+    OnionSkin() : target{}, bounds{ 0, 0, 0, 0 }, ghostCount(0), valid(false), shownSprite(nullptr), shownSheet(0),
+        shownFrameRec{ 0, 0, 0, 0 }, shownFrame(0), shownScale(0.0f), shownFacing(0.0f), shownTag(0), shownRowFrames(0),
+        rebuilds(0), rebuildMs(0.0), memoryCharge(MemoryPool::OnionSkin)
+    {
+    }
+
+    ~OnionSkin()
+    {
+        if (target.id != 0) UnloadRenderTexture(target);
+    }
+
+    OnionSkin(const OnionSkin&) = delete;
+    OnionSkin& operator=(const OnionSkin&) = delete;
+
+    // Redraw the ghosts if what they should show changed. tag_ and rowFrames_ are what the simulation plays:
+    // the frame table tag, or how many columns of a grid row. Call outside BeginDrawing()
+    void Update(const Sprite& sprite, const SpriteSnapshot& snapshot, int tag_, int rowFrames_, const OnionSkinSettings& settings_)
+    {
+        if (Shows(sprite, snapshot, tag_, rowFrames_, settings_)) return;
+
+        const auto start = std::chrono::steady_clock::now();
+        Rebuild(sprite, snapshot, tag_, rowFrames_, settings_);
+        rebuildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        rebuilds++;
+
+        valid = true;
+        shownSprite = &sprite;
+        shownSheet = sprite.GetTexture().id;
+        shownFrameRec = snapshot.frameRec;
+        shownFrame = snapshot.currentFrame;
+        shownScale = snapshot.frameScale;
+        shownFacing = snapshot.frameFacing;
+        shownTag = tag_;
+        shownRowFrames = rowFrames_;
+        shownSettings = settings_;
+    }
+
+    // A new sheet may reuse the old one's address and texture id
+    void Invalidate()
+    {
+        valid = false;
+    }
+
+    // One quad, for a sprite drawn at position
+    void Draw(Vector2 position) const
+    {
+        if (!valid || (ghostCount == 0) || (target.id == 0)) return;
+
+        // Render textures are stored upside down, and the ghosts fill the top left of a possibly larger one
+        const Rectangle source{ 0, static_cast<float>(target.texture.height) - bounds.height, bounds.width, -bounds.height };
+
+        BeginBlendMode(BLEND_ALPHA_PREMULTIPLY);
+        DrawTextureRec(target.texture, source, Vector2{ position.x + bounds.x, position.y + bounds.y }, WHITE);
+        EndBlendMode();
+    }
+
+    int GetGhostCount() const
+    {
+        return valid ? ghostCount : 0;
+    }
+
+    unsigned int GetRebuilds() const
+    {
+        return rebuilds;
+    }
+
+    double GetRebuildMs() const
+    {
+        return rebuildMs;
+    }
+
+    int GetTextureWidth() const
+    {
+        return target.texture.width;
+    }
+
+    int GetTextureHeight() const
+    {
+        return target.texture.height;
+    }
+};
@@ -0,0 +1,357 @@
+#pragma once
+
+#include "raylib.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define PIXEL_PIPELINE_X86
+#include <immintrin.h>
+#endif
+
+// 16-bit formats a sheet may be packed into at load time
+enum class PixelPackMode
+{
+    Keep = 0,   // Upload as loaded
+    Auto,       // Smallest 16-bit format within tolerance, else keep
+    R4G4B4A4,
+    R5G5B5A1,
+    R5G6B5
+};
+
+// What the pipeline did to a sheet and how fast
+struct PixelPipelineStats
+{
+    bool premultiplied = false;
+    int format = 0;                 // Final raylib PixelFormat
+    int maxError = 0;               // Largest per-channel error introduced by packing
+    size_t bytesIn = 0;
+    size_t bytesSaved = 0;
+    double premultiplyGBs = 0.0;
+    double packGBs = 0.0;
+    const char* kernel = "scalar";
+};
+
+//----------------------------------------------------------------------------------
+// Kernels
+//----------------------------------------------------------------------------------
+
+// round(x/255) for x in [0, 65025], exact, without a division
+static inline unsigned int DivRound255(unsigned int x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+static inline void PremultiplyScalar(unsigned char* rgba, size_t pixelCount)
+{
+    for (size_t i = 0; i < pixelCount; i++, rgba += 4)
+    {
+        const unsigned int a = rgba[3];
+        rgba[0] = static_cast<unsigned char>(DivRound255(rgba[0]*a));
+        rgba[1] = static_cast<unsigned char>(DivRound255(rgba[1]*a));
+        rgba[2] = static_cast<unsigned char>(DivRound255(rgba[2]*a));
+    }
+}
+
+// Channel levels and bit positions of a packed 16-bit format, channels in RGBA order
+struct PackLayout
+{
+    int format;
+    unsigned short levels[4];   // 2^bits - 1, 0 for a dropped channel
+    unsigned char shifts[4];
+};
+
+static inline PackLayout GetPackLayout(PixelPackMode mode)
+{
+    switch (mode)
+    {
+        case PixelPackMode::R4G4B4A4: return PackLayout{ PIXELFORMAT_UNCOMPRESSED_R4G4B4A4, { 15, 15, 15, 15 }, { 12, 8, 4, 0 } };
+        case PixelPackMode::R5G5B5A1: return PackLayout{ PIXELFORMAT_UNCOMPRESSED_R5G5B5A1, { 31, 31, 31, 1 }, { 11, 6, 1, 0 } };
+        default: return PackLayout{ PIXELFORMAT_UNCOMPRESSED_R5G6B5, { 31, 63, 31, 0 }, { 11, 5, 0, 0 } };
+    }
+}
+
+// Value the GPU reads back for a quantized channel, by bit replication
+static inline unsigned int ExpandLevel(unsigned int q, unsigned int levels)
+{
+    switch (levels)
+    {
+        case 1: return q*255;
+        case 15: return q*17;
+        case 31: return (q << 3) | (q >> 2);
+        case 63: return (q << 2) | (q >> 4);
+        default: return 255;
+    }
+}
+
+static inline void PackScalar(const unsigned char* rgba, unsigned short* out, size_t pixelCount, const PackLayout& layout)
+{
+    for (size_t i = 0; i < pixelCount; i++, rgba += 4)
+    {
+        unsigned int packed = 0;
+        for (int c = 0; c < 4; c++)
+        {
+            if (layout.levels[c] != 0) packed |= DivRound255(rgba[c]*layout.levels[c]) << layout.shifts[c];
+        }
+
+        out[i] = static_cast<unsigned short>(packed);
+    }
+}
+
+#if defined(PIXEL_PIPELINE_X86)
+// Four pixels per step: widen to 16 bits, multiply by the broadcast alpha, divide by 255 with rounding
+__attribute__((target("sse2"))) static inline void PremultiplySSE2(unsigned char* rgba, size_t pixelCount)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000));
+
+    size_t i = 0;
+    for (; i + 4 <= pixelCount; i += 4)
+    {
+        __m128i* p = reinterpret_cast<__m128i*>(rgba + i*4);
+        const __m128i pixels = _mm_loadu_si128(p);
+
+        __m128i lo = _mm_unpacklo_epi8(pixels, zero);
+        __m128i hi = _mm_unpackhi_epi8(pixels, zero);
+
+        const __m128i alphaLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        const __m128i alphaHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+        lo = _mm_add_epi16(_mm_mullo_epi16(lo, alphaLo), bias);
+        hi = _mm_add_epi16(_mm_mullo_epi16(hi, alphaHi), bias);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+        // Alpha itself is kept as is
+        const __m128i result = _mm_packus_epi16(lo, hi);
+        _mm_storeu_si128(p, _mm_or_si128(_mm_andnot_si128(alphaMask, result), _mm_and_si128(alphaMask, pixels)));
+    }
+
+    PremultiplyScalar(rgba + i*4, pixelCount - i);
+}
+
+__attribute__((target("avx2"))) static inline void PremultiplyAVX2(unsigned char* rgba, size_t pixelCount)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i bias = _mm256_set1_epi16(128);
+    const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+
+    // Broadcast the alpha word of each pixel over its four words
+    const __m256i alphaShuffle = _mm256_setr_epi8(6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15,
+                                                  6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15);
+
+    size_t i = 0;
+    for (; i + 8 <= pixelCount; i += 8)
+    {
+        __m256i* p = reinterpret_cast<__m256i*>(rgba + i*4);
+        const __m256i pixels = _mm256_loadu_si256(p);
+
+        __m256i lo = _mm256_unpacklo_epi8(pixels, zero);
+        __m256i hi = _mm256_unpackhi_epi8(pixels, zero);
+
+        lo = _mm256_add_epi16(_mm256_mullo_epi16(lo, _mm256_shuffle_epi8(lo, alphaShuffle)), bias);
+        hi = _mm256_add_epi16(_mm256_mullo_epi16(hi, _mm256_shuffle_epi8(hi, alphaShuffle)), bias);
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+
+        // unpack/pack both work within 128-bit lanes, so the pixel order comes back unchanged
+        const __m256i result = _mm256_packus_epi16(lo, hi);
+        _mm256_storeu_si256(p, _mm256_or_si256(_mm256_andnot_si256(alphaMask, result), _mm256_and_si256(alphaMask, pixels)));
+    }
+
+    PremultiplySSE2(rgba + i*4, pixelCount - i);
+}
+
+// Quantize four pixels in 16-bit lanes, narrow back to one byte per channel, then build the
+// packed words with 32-bit shifts: each pixel is r | g << 8 | b << 16 | a << 24 at that point
+__attribute__((target("sse2"))) static inline void PackSSE2(const unsigned char* rgba, unsigned short* out, size_t pixelCount, const PackLayout& layout)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128i levels = _mm_setr_epi16(layout.levels[0], layout.levels[1], layout.levels[2], layout.levels[3],
+                                          layout.levels[0], layout.levels[1], layout.levels[2], layout.levels[3]);
+
+    size_t i = 0;
+    for (; i + 8 <= pixelCount; i += 8)
+    {
+        __m128i words[2];
+
+        for (int half = 0; half < 2; half++)
+        {
+            const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + (i + half*4)*4));
+
+            __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), levels), bias);
+            __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), levels), bias);
+            lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+            hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+            const __m128i q = _mm_packus_epi16(lo, hi);
+            __m128i packed;
+
+            switch (layout.format)
+            {
+                case PIXELFORMAT_UNCOMPRESSED_R4G4B4A4:
+                {
+                    packed = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(0xF)), 12), _mm_and_si128(q, _mm_set1_epi32(0xF00))),
+                                          _mm_or_si128(_mm_and_si128(_mm_srli_epi32(q, 12), _mm_set1_epi32(0xF0)), _mm_srli_epi32(q, 24)));
+                } break;
+                case PIXELFORMAT_UNCOMPRESSED_R5G5B5A1:
+                {
+                    packed = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(0x1F)), 11), _mm_and_si128(_mm_srli_epi32(q, 2), _mm_set1_epi32(0x7C0))),
+                                          _mm_or_si128(_mm_and_si128(_mm_srli_epi32(q, 15), _mm_set1_epi32(0x3E)), _mm_srli_epi32(q, 24)));
+                } break;
+                default:
+                {
+                    packed = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(0x1F)), 11), _mm_and_si128(_mm_srli_epi32(q, 3), _mm_set1_epi32(0x7E0))),
+                                          _mm_and_si128(_mm_srli_epi32(q, 16), _mm_set1_epi32(0x1F)));
+                } break;
+            }
+
+            // Sign extend the low 16 bits so the signed saturating pack keeps the bit pattern
+            words[half] = _mm_srai_epi32(_mm_slli_epi32(packed, 16), 16);
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(words[0], words[1]));
+    }
+
+    PackScalar(rgba + i*4, out + i, pixelCount - i, layout);
+}
+
+static inline bool HasAVX2()
+{
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+
+//----------------------------------------------------------------------------------
+// Pipeline
+//----------------------------------------------------------------------------------
+
+// Largest per-channel error packing into a layout would introduce, -1 if it cannot represent the alpha
+static inline int MeasurePackError(const unsigned char* rgba, size_t pixelCount, const PackLayout& layout)
+{
+    // Per channel error of every possible byte value, the scan itself is then a few table lookups
+    unsigned char errors[4][256];
+    for (int c = 0; c < 4; c++)
+    {
+        for (unsigned int v = 0; v < 256; v++)
+        {
+            const int expanded = (layout.levels[c] != 0) ? static_cast<int>(ExpandLevel(DivRound255(v*layout.levels[c]), layout.levels[c])) : 255;
+            errors[c][v] = static_cast<unsigned char>(std::abs(expanded - static_cast<int>(v)));
+        }
+    }
+
+    int maxError = 0;
+    for (size_t i = 0; i < pixelCount; i++, rgba += 4)
+    {
+        const int error = std::max(std::max(errors[0][rgba[0]], errors[1][rgba[1]]), std::max(errors[2][rgba[2]], errors[3][rgba[3]]));
+        maxError = std::max(maxError, error);
+    }
+
+    return maxError;
+}
+
+// Premultiply and/or repack a sheet in place before it is uploaded. Auto picks the smallest
+// 16-bit layout whose error stays within tolerance; an explicit layout is only used if it does too.
+static inline PixelPipelineStats ProcessSheetPixels(Image* image, bool premultiply, PixelPackMode mode, int tolerance)
+{
+    PixelPipelineStats stats;
+    stats.format = image->format;
+
+    if ((image->data == nullptr) || (!premultiply && (mode == PixelPackMode::Keep))) return stats;
+
+    if (image->format != PIXELFORMAT_UNCOMPRESSED_R8G8B8A8) ImageFormat(image, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    if (image->format != PIXELFORMAT_UNCOMPRESSED_R8G8B8A8) return stats;
+
+    unsigned char* rgba = static_cast<unsigned char*>(image->data);
+    const size_t pixelCount = static_cast<size_t>(image->width)*image->height;
+    stats.bytesIn = pixelCount*4;
+    stats.format = image->format;
+
+    if (premultiply)
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+#if defined(PIXEL_PIPELINE_X86)
+        if (HasAVX2())
+        {
+            PremultiplyAVX2(rgba, pixelCount);
+            stats.kernel = "AVX2";
+        }
+        else
+        {
+            PremultiplySSE2(rgba, pixelCount);
+            stats.kernel = "SSE2";
+        }
+#else
+        PremultiplyScalar(rgba, pixelCount);
+#endif
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats.premultiplyGBs = (seconds > 0.0) ? stats.bytesIn/seconds/1e9 : 0.0;
+        stats.premultiplied = true;
+    }
+
+    if (mode == PixelPackMode::Keep) return stats;
+
+    // Candidates from smallest error to largest, the first that fits wins
+    PixelPackMode candidates[3];
+    int candidateCount = 0;
+
+    if (mode == PixelPackMode::Auto)
+    {
+        candidates[candidateCount++] = PixelPackMode::R5G6B5;
+        candidates[candidateCount++] = PixelPackMode::R5G5B5A1;
+        candidates[candidateCount++] = PixelPackMode::R4G4B4A4;
+    }
+    else candidates[candidateCount++] = mode;
+
+    for (int i = 0; i < candidateCount; i++)
+    {
+        const PackLayout layout = GetPackLayout(candidates[i]);
+        const int error = MeasurePackError(rgba, pixelCount, layout);
+        if (error > tolerance) continue;
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        unsigned short* packed = static_cast<unsigned short*>(RL_MALLOC(pixelCount*sizeof(unsigned short)));
+#if defined(PIXEL_PIPELINE_X86)
+        PackSSE2(rgba, packed, pixelCount, layout);
+#else
+        PackScalar(rgba, packed, pixelCount, layout);
+#endif
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats.packGBs = (seconds > 0.0) ? stats.bytesIn/seconds/1e9 : 0.0;
+
+        RL_FREE(image->data);
+        image->data = packed;
+        image->format = layout.format;
+
+        stats.format = layout.format;
+        stats.maxError = error;
+        stats.bytesSaved = pixelCount*2;
+        break;
+    }
+
+    return stats;
+}
+
+static inline const char* GetPixelFormatName(int format)
+{
+    switch (format)
+    {
+        case PIXELFORMAT_UNCOMPRESSED_R8G8B8A8: return "RGBA8888";
+        case PIXELFORMAT_UNCOMPRESSED_R8G8B8: return "RGB888";
+        case PIXELFORMAT_UNCOMPRESSED_R4G4B4A4: return "RGBA4444";
+        case PIXELFORMAT_UNCOMPRESSED_R5G5B5A1: return "RGBA5551";
+        case PIXELFORMAT_UNCOMPRESSED_R5G6B5: return "RGB565";
+        default: return "other";
+    }
+}
@@ -0,0 +1,618 @@
+#pragma once
+
+#include "sprite.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PREVIEW_DAEMON_SUPPORTED
+#include <csignal>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#define PREVIEW_PROTOCOL_MAGIC 0x44505653u   // "SVPD"
+#define PREVIEW_PROTOCOL_VERSION 1
+#define PREVIEW_MAX_SHEETS 16                // Decoded sheets kept warm, least recently used is dropped
+#define PREVIEW_MAX_CLIENTS 32
+#define PREVIEW_MAX_FRAME_PIXELS (4096*4096)
+#define PREVIEW_SEND_TIMEOUT_MS 1000         // A client that stops reading for this long is dropped
+
+// Fixed-size messages in host byte order, both ends run on the same machine
+struct PreviewRequest
+{
+    unsigned int magic;
+    unsigned int version;
+    char sheetPath[512];
+    int columns;
+    int rows;
+    int row;
+    int frame;
+    float frameScale;
+    float frameFacing;
+};
+
+enum class PreviewStatus : int
+{
+    Ok = 0,
+    BadRequest,
+    LoadFailed,
+    TooLarge,
+    NoSharedMemory
+};
+
+// The frame is in the shared memory object shmName as width*height RGBA8 pixels, valid until the next request
+struct PreviewResponse
+{
+    PreviewStatus status;
+    int width;
+    int height;
+    unsigned int sequence;
+    unsigned int cacheHit;
+    float renderMs;             // Time spent in the daemon, including any sheet decode
+    unsigned long long shmSize;
+    char shmName[64];
+};
+
+inline PreviewRequest MakePreviewRequest(const char* sheetPath, int columns, int rows, int row, int frame, float frameScale, float frameFacing)
+{
+    PreviewRequest request;
+    memset(&request, 0, sizeof(request));
+
+    request.magic = PREVIEW_PROTOCOL_MAGIC;
+    request.version = PREVIEW_PROTOCOL_VERSION;
+    strncpy(request.sheetPath, sheetPath, sizeof(request.sheetPath) - 1);
+    request.columns = columns;
+    request.rows = rows;
+    request.row = row;
+    request.frame = frame;
+    request.frameScale = frameScale;
+    request.frameFacing = frameFacing;
+
+    return request;
+}
+
+#if defined(PREVIEW_DAEMON_SUPPORTED)
+
+#if defined(MSG_NOSIGNAL)
+#define PREVIEW_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define PREVIEW_SEND_FLAGS 0
+#endif
+
+static inline bool PreviewSendAll(int fd, const void* data, size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0)
+    {
+        const ssize_t sent = send(fd, bytes, size, PREVIEW_SEND_FLAGS);
+        if (sent < 0 && errno == EINTR) continue;
+
+        // The daemon's sockets are non-blocking, a full socket buffer only means the client has not read yet
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            pollfd writable{ fd, POLLOUT, 0 };
+            const int ready = poll(&writable, 1, PREVIEW_SEND_TIMEOUT_MS);
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready <= 0 || (writable.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0) return false;
+            continue;
+        }
+
+        if (sent <= 0) return false;
+
+        bytes += sent;
+        size -= static_cast<size_t>(sent);
+    }
+
+    return true;
+}
+
+static inline bool PreviewReceiveAll(int fd, void* data, size_t size)
+{
+    char* bytes = static_cast<char*>(data);
+    while (size > 0)
+    {
+        const ssize_t received = recv(fd, bytes, size, 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return false;
+
+        bytes += received;
+        size -= static_cast<size_t>(received);
+    }
+
+    return true;
+}
+
+static inline bool MakePreviewAddress(const char* socketPath, sockaddr_un* address)
+{
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address->sun_path)) return false;
+
+    strcpy(address->sun_path, socketPath);
+    return true;
+}
+
+static volatile sig_atomic_t previewDaemonStop = 0;
+
+static inline void StopPreviewDaemon(int)
+{
+    previewDaemonStop = 1;
+}
+
+// Keeps decoded sheets in memory and renders single frames on the CPU backend for local clients
+class PreviewDaemon
+{
+private:
+    struct SheetEntry
+    {
+        std::string path;
+        int columns;
+        int rows;
+        long modTime;
+        unsigned long long lastUse;
+        std::unique_ptr<Sprite> sprite;
+    };
+
+    // One shared memory object per connection, grown as larger frames are asked for
+    struct Client
+    {
+        int fd;
+        PreviewRequest pending;
+        size_t received;
+
+        char shmName[64];
+        int shmFd;
+        void* shmData;
+        size_t shmSize;
+    };
+
+    std::vector<SheetEntry> sheets;
+    std::vector<Client> clients;
+    unsigned long long useClock;
+    unsigned int sequence;
+    unsigned int shmCounter;
+
+    SoftCanvas canvas;
+
+    SheetEntry* FindSheet(const PreviewRequest& request, bool* cacheHit)
+    {
+        const long modTime = GetFileModTime(request.sheetPath);
+
+        for (size_t i = 0; i < sheets.size(); i++)
+        {
+            SheetEntry& entry = sheets[i];
+            if ((entry.path != request.sheetPath) || (entry.columns != request.columns) || (entry.rows != request.rows)) continue;
+
+            // Edited on disk since it was decoded
+            if (entry.modTime != modTime)
+            {
+                sheets.erase(sheets.begin() + i);
+                break;
+            }
+
+            entry.lastUse = ++useClock;
+            *cacheHit = true;
+            return &entry;
+        }
+
+        *cacheHit = false;
+
+        Image image = LoadImage(request.sheetPath);
+        if (image.data == nullptr) return nullptr;
+
+        if (sheets.size() >= PREVIEW_MAX_SHEETS)
+        {
+            std::vector<SheetEntry>::iterator oldest = std::min_element(sheets.begin(), sheets.end(),
+                [](const SheetEntry& a, const SheetEntry& b) { return a.lastUse < b.lastUse; });
+            sheets.erase(oldest);
+        }
+
+        SpriteLoadOptions loadOptions;
+        loadOptions.uploadTexture = false;
+        loadOptions.keepSoftTexture = true;
+        loadOptions.buildMasks = false;     // Nothing here picks pixels or reads hitboxes
+
+        SheetEntry entry;
+        entry.path = request.sheetPath;
+        entry.columns = request.columns;
+        entry.rows = request.rows;
+        entry.modTime = modTime;
+        entry.lastUse = ++useClock;
+        entry.sprite = std::make_unique<Sprite>(Vector2{0, 0}, image, request.columns, request.rows, request.frameFacing, loadOptions);
+
+        if (!entry.sprite->HasSoftTexture()) return nullptr;
+
+        sheets.push_back(std::move(entry));
+        return &sheets.back();
+    }
+
+    bool ReserveSharedMemory(Client& client, size_t size)
+    {
+        if (client.shmSize >= size) return true;
+
+        if (client.shmFd < 0)
+        {
+            snprintf(client.shmName, sizeof(client.shmName), "/sprite-viewer-%d-%u", static_cast<int>(getpid()), ++shmCounter);
+            client.shmFd = shm_open(client.shmName, O_RDWR | O_CREAT | O_EXCL, 0600);
+            if (client.shmFd < 0) return false;
+        }
+
+        if (client.shmData != nullptr) munmap(client.shmData, client.shmSize);
+        client.shmData = nullptr;
+        client.shmSize = 0;
+
+        if (ftruncate(client.shmFd, static_cast<off_t>(size)) != 0) return false;
+
+        void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, client.shmFd, 0);
+        if (data == MAP_FAILED) return false;
+
+        client.shmData = data;
+        client.shmSize = size;
+        return true;
+    }
+
+    PreviewResponse Render(Client& client, const PreviewRequest& request)
+    {
+        // The daemon never opens a window, so GetTime() would stay at 0
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        PreviewResponse response;
+        memset(&response, 0, sizeof(response));
+        response.sequence = ++sequence;
+
+        if ((request.magic != PREVIEW_PROTOCOL_MAGIC) || (request.version != PREVIEW_PROTOCOL_VERSION) ||
+            (request.columns <= 0) || (request.rows <= 0) || (request.row < 0) || (request.row >= request.rows) ||
+            (request.frame < 0) || (request.frame >= request.columns) || !(request.frameScale > 0.0f) ||
+            ((request.frameFacing != 1.0f) && (request.frameFacing != -1.0f)) ||
+            (memchr(request.sheetPath, '\0', sizeof(request.sheetPath)) == nullptr))
+        {
+            response.status = PreviewStatus::BadRequest;
+            return response;
+        }
+
+        bool cacheHit = false;
+        SheetEntry* sheet = FindSheet(request, &cacheHit);
+        response.cacheHit = cacheHit ? 1 : 0;
+
+        if (sheet == nullptr)
+        {
+            response.status = PreviewStatus::LoadFailed;
+            return response;
+        }
+
+        const Sprite& sprite = *sheet->sprite;
+        const int frameWidth = sprite.GetSheetWidth()/request.columns;
+        const int frameHeight = sprite.GetSheetHeight()/request.rows;
+
+        // Sized in double and checked before narrowing, a huge scale would overflow an int
+        const double scaledWidth = std::floor(frameWidth*static_cast<double>(request.frameScale) + 0.5);
+        const double scaledHeight = std::floor(frameHeight*static_cast<double>(request.frameScale) + 0.5);
+
+        if (!(scaledWidth >= 1.0) || !(scaledHeight >= 1.0) || (scaledWidth*scaledHeight > PREVIEW_MAX_FRAME_PIXELS))
+        {
+            response.status = PreviewStatus::TooLarge;
+            return response;
+        }
+
+        const int width = static_cast<int>(scaledWidth);
+        const int height = static_cast<int>(scaledHeight);
+
+        const size_t bytes = static_cast<size_t>(width)*height*sizeof(Color);
+        if (!ReserveSharedMemory(client, bytes))
+        {
+            response.status = PreviewStatus::NoSharedMemory;
+            return response;
+        }
+
+        canvas.Resize(width, height);
+        canvas.ClearBackground(BLANK);
+        sprite.Draw(canvas, sprite.GetFrameSnapshot(Vector2{0, 0}, request.row, request.frame, request.frameScale, request.frameFacing));
+        memcpy(client.shmData, canvas.GetPixels(), bytes);
+
+        response.status = PreviewStatus::Ok;
+        response.width = width;
+        response.height = height;
+        response.shmSize = client.shmSize;
+        strcpy(response.shmName, client.shmName);
+        response.renderMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        return response;
+    }
+
+    void CloseClient(size_t index)
+    {
+        Client& client = clients[index];
+
+        if (client.shmData != nullptr) munmap(client.shmData, client.shmSize);
+        if (client.shmFd >= 0)
+        {
+            close(client.shmFd);
+            shm_unlink(client.shmName);
+        }
+
+        close(client.fd);
+        clients.erase(clients.begin() + index);
+    }
+
+    // false when the connection should be closed
+    bool ServeClient(Client& client)
+    {
+        char* buffer = reinterpret_cast<char*>(&client.pending);
+        const ssize_t received = recv(client.fd, buffer + client.received, sizeof(PreviewRequest) - client.received, 0);
+
+        if (received < 0) return (errno == EINTR) || (errno == EAGAIN) || (errno == EWOULDBLOCK);
+        if (received == 0) return false;
+
+        client.received += static_cast<size_t>(received);
+        if (client.received < sizeof(PreviewRequest)) return true;
+
+        client.received = 0;
+        const PreviewResponse response = Render(client, client.pending);
+        return PreviewSendAll(client.fd, &response, sizeof(response));
+    }
+
+public:
+    PreviewDaemon()
+        : useClock(0), sequence(0), shmCounter(0), canvas(1, 1)
+    {
+    }
+
+    ~PreviewDaemon()
+    {
+        while (!clients.empty()) CloseClient(clients.size() - 1);
+    }
+
+    // Serve until SIGINT or SIGTERM
+    int Run(const char* socketPath)
+    {
+        sockaddr_un address;
+        if (!MakePreviewAddress(socketPath, &address))
+        {
+            fprintf(stderr, "Socket path too long: %s\n", socketPath);
+            return 1;
+        }
+
+        // Only a stale socket is replaced, never a file that happens to have the name
+        struct stat existing;
+        if (lstat(socketPath, &existing) == 0)
+        {
+            if (!S_ISSOCK(existing.st_mode))
+            {
+                fprintf(stderr, "Not a socket, refusing to replace it: %s\n", socketPath);
+                return 1;
+            }
+
+            unlink(socketPath);
+        }
+
+        const int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd < 0) return 1;
+        if ((bind(listenFd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) || (listen(listenFd, 8) != 0))
+        {
+            fprintf(stderr, "Cannot listen on %s: %s\n", socketPath, strerror(errno));
+            close(listenFd);
+            return 1;
+        }
+
+        previewDaemonStop = 0;
+        signal(SIGINT, StopPreviewDaemon);
+        signal(SIGTERM, StopPreviewDaemon);
+        signal(SIGPIPE, SIG_IGN);
+
+        TraceLog(LOG_INFO, "PREVIEW: Listening on %s, rendering on %d threads", socketPath, canvas.GetThreadCount());
+
+        std::vector<pollfd> fds;
+
+        while (!previewDaemonStop)
+        {
+            fds.clear();
+            fds.push_back(pollfd{ listenFd, POLLIN, 0 });
+            for (const Client& client : clients) fds.push_back(pollfd{ client.fd, POLLIN, 0 });
+
+            // Wake up now and then to notice a stop signal
+            if (poll(fds.data(), fds.size(), 250) <= 0) continue;
+
+            // Clients first, so indices into fds still match clients
+            for (size_t i = fds.size() - 1; i >= 1; i--)
+            {
+                if (fds[i].revents == 0) continue;
+
+                const bool keep = ((fds[i].revents & POLLIN) != 0) && ServeClient(clients[i - 1]);
+                if (!keep) CloseClient(i - 1);
+            }
+
+            if ((fds[0].revents & POLLIN) != 0)
+            {
+                const int fd = accept(listenFd, nullptr, nullptr);
+                if (fd >= 0 && clients.size() >= PREVIEW_MAX_CLIENTS) close(fd);
+                else if (fd >= 0)
+                {
+                    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+                    Client client;
+                    memset(&client, 0, sizeof(client));
+                    client.fd = fd;
+                    client.shmFd = -1;
+                    clients.push_back(client);
+                }
+            }
+        }
+
+        TraceLog(LOG_INFO, "PREVIEW: Stopping after %u requests", sequence);
+
+        while (!clients.empty()) CloseClient(clients.size() - 1);
+        close(listenFd);
+        unlink(socketPath);
+
+        return 0;
+    }
+};
+
+// Connection to a running daemon, frames are read straight from its shared memory
+class PreviewClient
+{
+private:
+    int fd;
+    char shmName[64];
+    const void* shmData;
+    size_t shmSize;
+
+    void Unmap()
+    {
+        if (shmData != nullptr) munmap(const_cast<void*>(shmData), shmSize);
+        shmData = nullptr;
+        shmSize = 0;
+        shmName[0] = '\0';
+    }
+
+    bool Map(const PreviewResponse& response)
+    {
+        if ((shmData != nullptr) && (strcmp(shmName, response.shmName) == 0) && (shmSize == response.shmSize)) return true;
+
+        Unmap();
+
+        const int shmFd = shm_open(response.shmName, O_RDONLY, 0);
+        if (shmFd < 0) return false;
+
+        void* data = mmap(nullptr, static_cast<size_t>(response.shmSize), PROT_READ, MAP_SHARED, shmFd, 0);
+        close(shmFd);
+        if (data == MAP_FAILED) return false;
+
+        shmData = data;
+        shmSize = static_cast<size_t>(response.shmSize);
+        strcpy(shmName, response.shmName);
+        return true;
+    }
+
+public:
+    PreviewClient()
+        : fd(-1), shmData(nullptr), shmSize(0)
+    {
+        shmName[0] = '\0';
+    }
+
+    ~PreviewClient()
+    {
+        Disconnect();
+    }
+
+    PreviewClient(const PreviewClient&) = delete;
+    PreviewClient& operator=(const PreviewClient&) = delete;
+
+    bool Connect(const char* socketPath)
+    {
+        Disconnect();
+
+        sockaddr_un address;
+        if (!MakePreviewAddress(socketPath, &address)) return false;
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return false;
+
+        if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+        {
+            Disconnect();
+            return false;
+        }
+
+        return true;
+    }
+
+    void Disconnect()
+    {
+        Unmap();
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+
+    // On success pixels points at width*height RGBA8 pixels, valid until the next call
+    bool Render(const PreviewRequest& request, PreviewResponse* response, const Color** pixels)
+    {
+        *pixels = nullptr;
+        if (fd < 0) return false;
+
+        if (!PreviewSendAll(fd, &request, sizeof(request)) || !PreviewReceiveAll(fd, response, sizeof(*response))) return false;
+        if (response->status != PreviewStatus::Ok) return false;
+        if (!Map(*response)) return false;
+
+        *pixels = static_cast<const Color*>(shmData);
+        return true;
+    }
+};
+
+#endif
+
+// Run the daemon from the command line
+inline int RunPreviewDaemon(const char* socketPath)
+{
+#if defined(PREVIEW_DAEMON_SUPPORTED)
+    PreviewDaemon daemon;
+    return daemon.Run(socketPath);
+#else
+    (void)socketPath;
+    fprintf(stderr, "The preview daemon needs Unix domain sockets and POSIX shared memory\n");
+    return 1;
+#endif
+}
+
+// Ask a running daemon for one frame and save it, mostly for scripts and for checking a daemon is up
+inline int RunPreviewRequest(const char* socketPath, const PreviewRequest& request, const char* outputPath)
+{
+#if defined(PREVIEW_DAEMON_SUPPORTED)
+    PreviewClient client;
+    if (!client.Connect(socketPath))
+    {
+        fprintf(stderr, "No preview daemon on %s\n", socketPath);
+        return 1;
+    }
+
+    PreviewResponse response;
+    const Color* pixels = nullptr;
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const bool rendered = client.Render(request, &response, &pixels);
+    const double roundTripMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    if (!rendered)
+    {
+        fprintf(stderr, "Preview failed with status %d\n", static_cast<int>(response.status));
+        return 1;
+    }
+
+    printf("Frame %dx%d, %s, %.3f ms in daemon, %.3f ms round trip\n", response.width, response.height,
+           response.cacheHit ? "cached sheet" : "sheet decoded", response.renderMs, roundTripMs);
+
+    Image image = { 0 };
+    image.width = response.width;
+    image.height = response.height;
+    image.mipmaps = 1;
+    image.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8;
+    image.data = RL_MALLOC(static_cast<size_t>(response.width)*response.height*sizeof(Color));
+    memcpy(image.data, pixels, static_cast<size_t>(response.width)*response.height*sizeof(Color));
+
+    const bool exported = ExportImage(image, outputPath);
+    UnloadImage(image);
+
+    return exported ? 0 : 1;
+#else
+    (void)socketPath;
+    (void)request;
+    (void)outputPath;
+    fprintf(stderr, "The preview daemon needs Unix domain sockets and POSIX shared memory\n");
+    return 1;
+#endif
+}
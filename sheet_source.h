@@ -0,0 +1,110 @@
+#pragma once
+
+#include "raylib.h"
+#include "frame_table.h"
+#include "frame_import.h"
+#include "aseprite.h"
+#include "frame_sidecar.h"
+
+#include <memory>
+#include <string>
+
+// A decoded sheet from any supported source, ready to hand to Sprite
+struct SheetSource
+{
+    Image image = { 0 };            // Null when loading failed, see error
+    int columns = 0;
+    int rows = 0;
+    std::shared_ptr<const FrameTable> frames;
+    bool ownGrid = false;           // columns and rows came from the source, not the caller
+    std::string info;               // One line summary for the UI
+    std::string error;
+};
+
+inline bool IsAsepriteFile(const char* path)
+{
+    return HasFileExtension(path, ".ase;.aseprite");
+}
+
+// Sources that decide their own grid instead of using the Columns and Rows settings. An image with a sidecar next
+// to it is not one of them until the sidecar parses, LoadSheetSource() reports that through SheetSource::ownGrid
+inline bool HasOwnGrid(const char* path)
+{
+    return IsAsepriteFile(path) || IsSidecarFile(path) || IsFrameSource(path);
+}
+
+// Load a sheet image, a packed sheet described by a JSON sidecar, a folder or pattern of frames, or an Aseprite file.
+// A JSON path loads the image it names, an image path picks up a sidecar of the same name next to it and is
+// loaded as a plain grid if that sidecar holds no frames. columns and rows are used for plain images; a folder
+// import only uses columns, and only when > 0.
+// Safe to call from a job worker: nothing here touches raylib's shared text buffers
+inline SheetSource LoadSheetSource(const char* path, int columns, int rows)
+{
+    SheetSource source;
+    char info[128] = { 0 };
+
+    if (IsAsepriteFile(path))
+    {
+        AsepriteSheet aseprite = LoadAseprite(path);
+
+        source.image = aseprite.sheet;
+        source.columns = aseprite.columns;
+        source.rows = aseprite.rows;
+        source.frames = aseprite.frames;
+        source.ownGrid = true;
+        source.error = aseprite.error;
+        snprintf(info, sizeof(info), "Aseprite: %d frames, %d tags in %.1f ms (%d threads)", aseprite.frameCount,
+                 aseprite.frames ? aseprite.frames->GetTagCount() : 0, aseprite.totalMs, aseprite.threads);
+    }
+    else if (IsSidecarFile(path) || HasFrameSidecar(path))
+    {
+        const bool fromJson = IsSidecarFile(path);
+        FrameSidecar sidecar = LoadFrameSidecar(fromJson ? path : GetSidecarPath(path).c_str());
+
+        if (sidecar.frames)
+        {
+            const std::string imagePath = fromJson ? sidecar.imagePath : std::string(path);
+            source.image = LoadImage(imagePath.c_str());
+            if (source.image.data == nullptr) source.error = "Cannot load " + imagePath;
+
+            // Frames are placed by the table, the grid is the whole sheet
+            source.columns = 1;
+            source.rows = 1;
+            source.frames = sidecar.frames;
+            source.ownGrid = true;
+            snprintf(info, sizeof(info), "Sidecar: %d frames, %d tags, %.1f KB parsed in %.2f ms", sidecar.frames->GetFrameCount(),
+                     sidecar.frames->GetTagCount(), sidecar.bytes/1024.0, sidecar.parseMs);
+        }
+        else if (fromJson) source.error = sidecar.error;
+        else
+        {
+            // Any JSON can sit next to an image, one that is not an atlas leaves it a plain grid
+            source.image = LoadImage(path);
+            source.columns = columns;
+            source.rows = rows;
+            if (source.image.data == nullptr) source.error = std::string("Cannot load ") + path;
+            snprintf(info, sizeof(info), "Sidecar ignored: %s", sidecar.error.c_str());
+        }
+    }
+    else if (IsFrameSource(path))
+    {
+        FrameImport import = ImportFrameFolder(path, columns);
+
+        source.image = import.sheet;
+        source.columns = import.columns;
+        source.rows = import.rows;
+        source.ownGrid = true;
+        source.error = import.error;
+        snprintf(info, sizeof(info), "Imported %d frames in %.1f ms (%d threads)", import.frameCount, import.totalMs, import.threads);
+    }
+    else
+    {
+        source.image = LoadImage(path);
+        source.columns = columns;
+        source.rows = rows;
+        if (source.image.data == nullptr) source.error = std::string("Cannot load ") + path;
+    }
+
+    source.info = info;
+    return source;
+}
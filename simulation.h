@@ -0,0 +1,365 @@
+#pragma once
+
+#include "sprite.h"
+#include "frame_pacer.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <utility>
+
+#define MAX_SIM_SPRITES 8
+#define SIM_COMMAND_CAPACITY 256
+
+// Lock-free triple buffer: one writer publishes whole values, one reader always gets the newest complete one
+template <typename T>
+class TripleBuffer
+{
+private:
+    static const unsigned int indexMask = 0x3;
+    static const unsigned int freshBit = 0x4;
+
+    T buffers[3];
+    std::atomic<unsigned int> middle;
+    unsigned int back;
+    unsigned int front;
+
+public:
+    TripleBuffer() : buffers{}, middle(1), back(0), front(2) {}
+
+    // Writer side
+    T& WriteBuffer()
+    {
+        return buffers[back];
+    }
+
+    void Publish()
+    {
+        back = middle.exchange(back | freshBit, std::memory_order_acq_rel) & indexMask;
+    }
+
+    // Reader side, returns true when a newer value was swapped in
+    bool Consume()
+    {
+        if ((middle.load(std::memory_order_acquire) & freshBit) == 0) return false;
+
+        front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    const T& ReadBuffer() const
+    {
+        return buffers[front];
+    }
+};
+
+// Lock-free single producer/single consumer ring buffer, Capacity must be a power of two
+template <typename T, unsigned int Capacity>
+class SpscQueue
+{
+private:
+    static_assert((Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+    T items[Capacity];
+    alignas(64) std::atomic<unsigned int> head {0};
+    alignas(64) std::atomic<unsigned int> tail {0};
+
+public:
+    bool Push(const T& item)
+    {
+        const unsigned int t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Capacity) return false;
+
+        items[t & (Capacity - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(T& item)
+    {
+        const unsigned int h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+
+        item = std::move(items[h & (Capacity - 1)]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+// Playback settings coming from the UI
+struct SpriteParams
+{
+    Vector2 position;
+    float frameScale;
+    float frameSpeed;
+    float frameFacing;
+    int totalFrames;
+    bool advanceRow;
+};
+
+inline bool operator==(const SpriteParams& a, const SpriteParams& b)
+{
+    return a.position.x == b.position.x && a.position.y == b.position.y &&
+           a.frameScale == b.frameScale && a.frameSpeed == b.frameSpeed && a.frameFacing == b.frameFacing &&
+           a.totalFrames == b.totalFrames && a.advanceRow == b.advanceRow;
+}
+
+inline bool operator!=(const SpriteParams& a, const SpriteParams& b)
+{
+    return !(a == b);
+}
+
+enum class SimCommandType
+{
+    SetSheet,   // Start animating a newly loaded sheet in a slot
+    SetParams,  // Change playback settings
+    SetRow,     // Jump to a row picked in the UI
+    Clear       // Stop animating a slot
+};
+
+struct SimCommand
+{
+    SimCommandType type;
+    int slot;
+    unsigned int version;
+
+    // SetSheet
+    int sheetWidth;
+    int sheetHeight;
+    int frameColumns;
+    int frameRows;
+    std::shared_ptr<const FrameTable> frames;   // Durations and tags drive playback when set
+
+    // SetParams
+    SpriteParams params;
+
+    // SetRow
+    int selectedRow;
+
+    static SimCommand Sheet(int slot_, unsigned int version_, int sheetWidth_, int sheetHeight_, int frameColumns_, int frameRows_,
+                            const std::shared_ptr<const FrameTable>& frames_ = nullptr)
+    {
+        SimCommand command {SimCommandType::SetSheet, slot_, version_};
+        command.sheetWidth = sheetWidth_;
+        command.sheetHeight = sheetHeight_;
+        command.frameColumns = frameColumns_;
+        command.frameRows = frameRows_;
+        command.frames = frames_;
+        return command;
+    }
+
+    static SimCommand Params(int slot_, const SpriteParams& params_)
+    {
+        SimCommand command {SimCommandType::SetParams, slot_, 0};
+        command.params = params_;
+        return command;
+    }
+
+    static SimCommand Row(int slot_, unsigned int version_, int selectedRow_)
+    {
+        SimCommand command {SimCommandType::SetRow, slot_, version_};
+        command.selectedRow = selectedRow_;
+        return command;
+    }
+
+    static SimCommand Clear(int slot_, unsigned int version_)
+    {
+        return SimCommand {SimCommandType::Clear, slot_, version_};
+    }
+};
+
+// Per-sprite state published to the render thread
+struct SimSpriteState
+{
+    bool active;
+    unsigned int sheetVersion;  // Matches the SetSheet command this state belongs to
+    unsigned int rowVersion;    // Matches the last SetRow command applied
+    int selectedRow;
+    SpriteSnapshot frame;
+};
+
+struct SimSnapshot
+{
+    unsigned long long tick;
+    float tickMs;               // Cost of the tick that produced this snapshot
+    SimSpriteState sprites[MAX_SIM_SPRITES];
+};
+
+// Steps all sprite animations at a fixed rate on its own thread, independently of rendering
+class Simulation
+{
+private:
+    struct Slot
+    {
+        bool active;
+        bool hasAdvancedRow;
+        unsigned int sheetVersion;
+        unsigned int rowVersion;
+        int selectedRow;            // Tag index when playing a frame table
+        SpriteParams params;
+        SpriteAnimation animation;
+        std::shared_ptr<const FrameTable> frames;
+    };
+
+    const int tickRate;
+    Slot slots[MAX_SIM_SPRITES];
+    unsigned long long tick;
+
+    SpscQueue<SimCommand, SIM_COMMAND_CAPACITY> commands;
+    TripleBuffer<SimSnapshot> snapshots;
+
+    std::thread worker;
+    std::atomic<bool> running;
+
+    void Apply(const SimCommand& command)
+    {
+        if ((command.slot < 0) || (command.slot >= MAX_SIM_SPRITES)) return;
+
+        Slot& slot = slots[command.slot];
+
+        switch (command.type)
+        {
+            case SimCommandType::SetSheet:
+            {
+                // Every cell needs at least a pixel, a zero frame size would divide by zero when stepping
+                slot.active = (command.frameColumns > 0) && (command.frameRows > 0) &&
+                              (command.sheetWidth >= command.frameColumns) && (command.sheetHeight >= command.frameRows);
+                slot.hasAdvancedRow = false;
+                slot.sheetVersion = command.version;
+                slot.frames = (command.frames && (command.frames->GetFrameCount() > 0)) ? command.frames : nullptr;
+                if (slot.active) slot.animation.Init(slot.params.position, command.sheetWidth, command.sheetHeight, command.frameColumns, command.frameRows, slot.params.frameFacing);
+            } break;
+            case SimCommandType::SetParams: slot.params = command.params; break;
+            case SimCommandType::SetRow:
+            {
+                slot.selectedRow = command.selectedRow;
+                slot.rowVersion = command.version;
+            } break;
+            case SimCommandType::Clear:
+            {
+                slot.active = false;
+                slot.frames.reset();
+            } break;
+        }
+    }
+
+    void StepSlot(Slot& slot)
+    {
+        // Frame durations replace frameSpeed where they are set, and tags replace the automatic row advance
+        if (slot.frames)
+        {
+            slot.animation.StepTimeline(*slot.frames, slot.selectedRow, 1.0f/tickRate, slot.params.position, slot.params.frameScale, slot.params.frameSpeed, slot.params.frameFacing);
+            return;
+        }
+
+        const SpriteAnimation& animation = slot.animation;
+        const int totalFrames = slot.params.totalFrames;
+
+        // Advance to the next row once the last frame of the current one has been shown
+        if ((animation.currentFrame + 1) >= totalFrames && !slot.hasAdvancedRow)
+        {
+            slot.selectedRow = slot.selectedRow + 1;
+            slot.hasAdvancedRow = true;
+        }
+        else if (animation.currentFrame < totalFrames && slot.selectedRow == animation.frameRows)
+        {
+            slot.selectedRow = 0;
+            slot.hasAdvancedRow = false;
+        }
+        else if (animation.currentFrame < totalFrames)
+        {
+            slot.hasAdvancedRow = false;
+        }
+
+        slot.animation.Step(tickRate, 1.0f/tickRate, slot.params.position, slot.params.frameScale, slot.params.frameSpeed,
+                            slot.selectedRow, slot.params.frameFacing, totalFrames, slot.params.advanceRow);
+    }
+
+    void Run()
+    {
+        // Absolute deadlines, so timing does not drift with tick cost, and spun the last stretch so ticks
+        // do not land a timer period late
+        FramePacer pacer(tickRate);
+
+        while (running.load(std::memory_order_acquire))
+        {
+            Tick();
+            pacer.Wait();
+        }
+    }
+
+public:
+    explicit Simulation(int tickRate_ = 60) : tickRate(tickRate_), slots{}, tick(0), running(false) {}
+
+    ~Simulation()
+    {
+        Stop();
+    }
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    int GetTickRate() const
+    {
+        return tickRate;
+    }
+
+    void Start()
+    {
+        if (running.exchange(true)) return;
+        worker = std::thread(&Simulation::Run, this);
+    }
+
+    void Stop()
+    {
+        if (!running.exchange(false)) return;
+        if (worker.joinable()) worker.join();
+    }
+
+    // UI thread: queue a change, returns false if the queue is full
+    bool Submit(const SimCommand& command)
+    {
+        return commands.Push(command);
+    }
+
+    // Render thread: latest published state
+    const SimSnapshot& Acquire()
+    {
+        snapshots.Consume();
+        return snapshots.ReadBuffer();
+    }
+
+    // Apply pending commands, advance every active sprite by one step and publish the result
+    // NOTE: Called from the simulation thread, or directly when no thread has been started
+    void Tick()
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        SimCommand command;
+        while (commands.Pop(command)) Apply(command);
+
+        for (int i = 0; i < MAX_SIM_SPRITES; i++)
+        {
+            if (slots[i].active) StepSlot(slots[i]);
+        }
+
+        tick++;
+
+        SimSnapshot& snapshot = snapshots.WriteBuffer();
+        snapshot.tick = tick;
+
+        for (int i = 0; i < MAX_SIM_SPRITES; i++)
+        {
+            SimSpriteState& state = snapshot.sprites[i];
+            state.active = slots[i].active;
+            state.sheetVersion = slots[i].sheetVersion;
+            state.rowVersion = slots[i].rowVersion;
+            state.selectedRow = slots[i].selectedRow;
+            state.frame = slots[i].animation.GetSnapshot();
+        }
+
+        snapshot.tickMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        snapshots.Publish();
+    }
+};
@@ -0,0 +1,665 @@
+#pragma once
+
+#include "raylib.h"
+#include "pixel_pipeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define SOFT_RENDER_MAX_THREADS 8
+#define SOFT_RENDER_PARALLEL_PIXELS 16384   // Smaller draws are not worth waking the workers for
+#define SOFT_RENDER_SPAN 256                // Pixels gathered per step of a blit
+
+// Sheet pixels for the CPU backend, always RGBA8
+struct SoftTexture
+{
+    int width = 0;
+    int height = 0;
+    std::vector<Color> pixels;
+};
+
+// Convert to RGBA8. Packed 16-bit sheets are expanded the way the GPU samples them
+inline SoftTexture LoadSoftTexture(const Image& image)
+{
+    SoftTexture texture;
+    if (image.data == nullptr) return texture;
+
+    texture.width = image.width;
+    texture.height = image.height;
+    texture.pixels.resize(static_cast<size_t>(image.width)*image.height);
+
+    PixelPackMode packMode = PixelPackMode::Keep;
+    if (image.format == PIXELFORMAT_UNCOMPRESSED_R4G4B4A4) packMode = PixelPackMode::R4G4B4A4;
+    else if (image.format == PIXELFORMAT_UNCOMPRESSED_R5G5B5A1) packMode = PixelPackMode::R5G5B5A1;
+    else if (image.format == PIXELFORMAT_UNCOMPRESSED_R5G6B5) packMode = PixelPackMode::R5G6B5;
+
+    if (packMode != PixelPackMode::Keep)
+    {
+        const PackLayout layout = GetPackLayout(packMode);
+        const unsigned short* packed = static_cast<const unsigned short*>(image.data);
+
+        for (size_t i = 0; i < texture.pixels.size(); i++)
+        {
+            unsigned char channels[4];
+            for (int c = 0; c < 4; c++)
+            {
+                const unsigned int q = (packed[i] >> layout.shifts[c]) & layout.levels[c];
+                channels[c] = static_cast<unsigned char>((layout.levels[c] != 0) ? ExpandLevel(q, layout.levels[c]) : 255);
+            }
+
+            texture.pixels[i] = Color{ channels[0], channels[1], channels[2], channels[3] };
+        }
+
+        return texture;
+    }
+
+    Image rgba = ImageCopy(image);
+    if (rgba.format != PIXELFORMAT_UNCOMPRESSED_R8G8B8A8) ImageFormat(&rgba, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+
+    if ((rgba.data != nullptr) && (rgba.format == PIXELFORMAT_UNCOMPRESSED_R8G8B8A8)) memcpy(texture.pixels.data(), rgba.data, texture.pixels.size()*sizeof(Color));
+    else texture = SoftTexture();
+
+    UnloadImage(rgba);
+    return texture;
+}
+
+//----------------------------------------------------------------------------------
+// Blend kernels
+//----------------------------------------------------------------------------------
+
+// Same factors raylib sets for its blend modes, applied to all four channels:
+// BLEND_ALPHA is src*a + dst*(1 - a), BLEND_ALPHA_PREMULTIPLY is src + dst*(1 - a)
+static inline void BlendSpanScalar(Color* dst, const Color* src, int count, bool premultiplied)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const unsigned int a = src[i].a;
+        if (a == 0 && !premultiplied) continue;
+
+        unsigned char* d = &dst[i].r;
+        const unsigned char* s = &src[i].r;
+
+        for (int c = 0; c < 4; c++)
+        {
+            const unsigned int value = premultiplied ? s[c] + DivRound255(d[c]*(255 - a)) : DivRound255(s[c]*a + d[c]*(255 - a));
+            d[c] = static_cast<unsigned char>(std::min(value, 255u));
+        }
+    }
+}
+
+#if defined(PIXEL_PIPELINE_X86)
+// round(x/255) per 16-bit lane, exact for x in [0, 65025]
+__attribute__((target("sse2"))) static inline __m128i DivRound255SSE2(__m128i x)
+{
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// Four pixels per step in 16-bit lanes. Runs that are fully transparent or fully opaque skip the math
+__attribute__((target("sse2"))) static inline void BlendSpanSSE2(Color* dst, const Color* src, int count, bool premultiplied)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+    const __m128i max = _mm_set1_epi16(255);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i alpha = _mm_and_si128(s, alphaMask);
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alphaMask)) == 0xFFFF)
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), s);
+            continue;
+        }
+
+        if (!premultiplied && (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero)) == 0xFFFF)) continue;
+
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+
+        const __m128i sLo = _mm_unpacklo_epi8(s, zero);
+        const __m128i sHi = _mm_unpackhi_epi8(s, zero);
+        const __m128i dLo = _mm_unpacklo_epi8(d, zero);
+        const __m128i dHi = _mm_unpackhi_epi8(d, zero);
+
+        const __m128i aLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sLo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        const __m128i aHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sHi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+        const __m128i dstLo = _mm_mullo_epi16(dLo, _mm_sub_epi16(max, aLo));
+        const __m128i dstHi = _mm_mullo_epi16(dHi, _mm_sub_epi16(max, aHi));
+
+        __m128i result;
+        if (premultiplied)
+        {
+            result = _mm_adds_epu8(s, _mm_packus_epi16(DivRound255SSE2(dstLo), DivRound255SSE2(dstHi)));
+        }
+        else
+        {
+            const __m128i lo = DivRound255SSE2(_mm_add_epi16(_mm_mullo_epi16(sLo, aLo), dstLo));
+            const __m128i hi = DivRound255SSE2(_mm_add_epi16(_mm_mullo_epi16(sHi, aHi), dstHi));
+            result = _mm_packus_epi16(lo, hi);
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), result);
+    }
+
+    BlendSpanScalar(dst + i, src + i, count - i, premultiplied);
+}
+#endif
+
+static inline void BlendSpan(Color* dst, const Color* src, int count, bool premultiplied)
+{
+#if defined(PIXEL_PIPELINE_X86)
+    BlendSpanSSE2(dst, src, count, premultiplied);
+#else
+    BlendSpanScalar(dst, src, count, premultiplied);
+#endif
+}
+
+//----------------------------------------------------------------------------------
+// Row-band worker pool
+//----------------------------------------------------------------------------------
+
+// Splits a draw into horizontal bands; the calling thread works on bands too and returns once all are done
+class SoftRenderPool
+{
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    // The draw's own lambda and a caller for it; a std::function would allocate for most of them every draw
+    const void* job;
+    void (*invoke)(const void* job, int first, int end);
+    int rowCount;
+    int bandRows;
+    std::atomic<int> nextBand;
+    unsigned int generation;
+    int busy;
+    bool stopping;
+
+    void RunBands()
+    {
+        for (;;)
+        {
+            const int start = nextBand.fetch_add(1)*bandRows;
+            if (start >= rowCount) break;
+            invoke(job, start, std::min(start + bandRows, rowCount));
+        }
+    }
+
+    void WorkerLoop()
+    {
+        unsigned int seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+
+        for (;;)
+        {
+            wake.wait(lock, [&]() { return stopping || (generation != seen); });
+            if (stopping) return;
+            seen = generation;
+
+            lock.unlock();
+            RunBands();
+            lock.lock();
+
+            if (--busy == 0) done.notify_one();
+        }
+    }
+
+public:
+    explicit SoftRenderPool(int threads_ = 0)
+        : job(nullptr), invoke(nullptr), rowCount(0), bandRows(1), nextBand(0), generation(0), busy(0), stopping(false)
+    {
+        int threads = (threads_ > 0) ? threads_ : static_cast<int>(std::thread::hardware_concurrency());
+        threads = std::max(1, std::min(threads, SOFT_RENDER_MAX_THREADS));
+
+        for (int i = 1; i < threads; i++) workers.emplace_back(&SoftRenderPool::WorkerLoop, this);
+    }
+
+    ~SoftRenderPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        wake.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    SoftRenderPool(const SoftRenderPool&) = delete;
+    SoftRenderPool& operator=(const SoftRenderPool&) = delete;
+
+    int GetThreadCount() const
+    {
+        return static_cast<int>(workers.size()) + 1;
+    }
+
+    // Call fn(firstRow, endRow) over [0, rows); big enough draws are spread over all threads
+    template <typename Fn>
+    void Run(int rows, int pixelsPerRow, const Fn& fn)
+    {
+        if (rows <= 0) return;
+
+        if (workers.empty() || (static_cast<long long>(rows)*pixelsPerRow < SOFT_RENDER_PARALLEL_PIXELS))
+        {
+            fn(0, rows);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &fn;
+            invoke = [](const void* job_, int first, int end) { (*static_cast<const Fn*>(job_))(first, end); };
+            rowCount = rows;
+            bandRows = std::max(4, rows/(4*GetThreadCount()));
+            nextBand = 0;
+            busy = static_cast<int>(workers.size());
+            generation++;
+        }
+
+        wake.notify_all();
+        RunBands();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&]() { return busy == 0; });
+        job = nullptr;
+    }
+};
+
+//----------------------------------------------------------------------------------
+// Canvases
+//----------------------------------------------------------------------------------
+
+// In-memory RGBA8 framebuffer with the subset of raylib drawing calls the viewer uses.
+// Needs no window or GL context, so previews can be rendered on machines without a GPU.
+class SoftCanvas
+{
+private:
+    int width;
+    int height;
+    std::vector<Color> pixels;
+    int blendMode;
+
+    SoftRenderPool pool;
+    std::vector<int> columnMap;     // Destination column -> texture column of the current blit
+
+    // Destination pixel range a float span covers, a pixel is covered when its center is
+    static void CoveredRange(float start, float size, int limit, int* first, int* end)
+    {
+        *first = std::max(0, static_cast<int>(std::ceil(start - 0.5f)));
+        *end = std::min(limit, static_cast<int>(std::ceil(start + size - 0.5f)));
+    }
+
+    void FillRect(int x0, int y0, int x1, int y1, Color color)
+    {
+        x0 = std::max(x0, 0);
+        y0 = std::max(y0, 0);
+        x1 = std::min(x1, width);
+        y1 = std::min(y1, height);
+        if ((x0 >= x1) || (y0 >= y1) || (color.a == 0)) return;
+
+        const bool premultiplied = (blendMode == BLEND_ALPHA_PREMULTIPLY);
+
+        pool.Run(y1 - y0, x1 - x0, [&](int first, int end)
+        {
+            Color span[SOFT_RENDER_SPAN];
+            std::fill(span, span + SOFT_RENDER_SPAN, color);
+
+            for (int y = y0 + first; y < y0 + end; y++)
+            {
+                Color* row = pixels.data() + static_cast<size_t>(y)*width;
+
+                if (color.a == 255) std::fill(row + x0, row + x1, color);
+                else
+                {
+                    for (int x = x0; x < x1; x += SOFT_RENDER_SPAN) BlendSpan(row + x, span, std::min(SOFT_RENDER_SPAN, x1 - x), premultiplied);
+                }
+            }
+        });
+    }
+
+    static void TintSpan(Color* span, int count, Color tint)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            span[i].r = static_cast<unsigned char>(DivRound255(span[i].r*tint.r));
+            span[i].g = static_cast<unsigned char>(DivRound255(span[i].g*tint.g));
+            span[i].b = static_cast<unsigned char>(DivRound255(span[i].b*tint.b));
+            span[i].a = static_cast<unsigned char>(DivRound255(span[i].a*tint.a));
+        }
+    }
+
+    // Slow path of DrawTexturePro: every covered pixel center is mapped back into the unrotated quad.
+    // Only rotated atlas frames take it
+    void DrawTextureRotated(const SoftTexture& texture, Rectangle source, Rectangle dest, Vector2 origin, float rotation, Color tint)
+    {
+        const bool flipX = (source.width < 0);
+        const bool flipY = (source.height < 0);
+        if (flipX) source.width = -source.width;
+        if (flipY) source.height = -source.height;
+
+        const float radians = rotation*DEG2RAD;
+        const float sinRotation = std::sin(radians);
+        const float cosRotation = std::cos(radians);
+
+        // Bounds of the rotated quad on the canvas
+        float minX = dest.x, maxX = dest.x, minY = dest.y, maxY = dest.y;
+        const float cornersX[4] = { -origin.x, dest.width - origin.x, dest.width - origin.x, -origin.x };
+        const float cornersY[4] = { -origin.y, -origin.y, dest.height - origin.y, dest.height - origin.y };
+        for (int i = 0; i < 4; i++)
+        {
+            const float x = dest.x + cornersX[i]*cosRotation - cornersY[i]*sinRotation;
+            const float y = dest.y + cornersX[i]*sinRotation + cornersY[i]*cosRotation;
+            minX = (i == 0) ? x : std::min(minX, x);
+            maxX = (i == 0) ? x : std::max(maxX, x);
+            minY = (i == 0) ? y : std::min(minY, y);
+            maxY = (i == 0) ? y : std::max(maxY, y);
+        }
+
+        int x0, x1, y0, y1;
+        CoveredRange(minX, maxX - minX, width, &x0, &x1);
+        CoveredRange(minY, maxY - minY, height, &y0, &y1);
+        if ((x0 >= x1) || (y0 >= y1)) return;
+
+        const bool tinted = (tint.r != 255) || (tint.g != 255) || (tint.b != 255) || (tint.a != 255);
+        const bool premultiplied = (blendMode == BLEND_ALPHA_PREMULTIPLY);
+
+        pool.Run(y1 - y0, x1 - x0, [&](int first, int end)
+        {
+            for (int y = y0 + first; y < y0 + end; y++)
+            {
+                Color* row = pixels.data() + static_cast<size_t>(y)*width;
+                const float ry = y + 0.5f - dest.y;
+
+                for (int x = x0; x < x1; x++)
+                {
+                    const float rx = x + 0.5f - dest.x;
+                    float u = (rx*cosRotation + ry*sinRotation + origin.x)/dest.width;
+                    float v = (ry*cosRotation - rx*sinRotation + origin.y)/dest.height;
+                    if ((u < 0.0f) || (u >= 1.0f) || (v < 0.0f) || (v >= 1.0f)) continue;
+
+                    if (flipX) u = 1.0f - u;
+                    if (flipY) v = 1.0f - v;
+
+                    const int column = std::max(0, std::min(static_cast<int>(std::floor(source.x + u*source.width)), texture.width - 1));
+                    const int sourceRow = std::max(0, std::min(static_cast<int>(std::floor(source.y + v*source.height)), texture.height - 1));
+
+                    Color pixel = texture.pixels[static_cast<size_t>(sourceRow)*texture.width + column];
+                    if (tinted) TintSpan(&pixel, 1, tint);
+                    BlendSpanScalar(row + x, &pixel, 1, premultiplied);
+                }
+            }
+        });
+    }
+
+public:
+    SoftCanvas(int width_, int height_, int threads_ = 0)
+        : width(width_), height(height_), pixels(static_cast<size_t>(width_)*height_, BLANK), blendMode(BLEND_ALPHA), pool(threads_)
+    {
+    }
+
+    // Keeps the worker pool; contents are undefined until the next clear
+    void Resize(int width_, int height_)
+    {
+        width = width_;
+        height = height_;
+        pixels.resize(static_cast<size_t>(width_)*height_);
+    }
+
+    int GetWidth() const
+    {
+        return width;
+    }
+
+    int GetHeight() const
+    {
+        return height;
+    }
+
+    int GetThreadCount() const
+    {
+        return pool.GetThreadCount();
+    }
+
+    const Color* GetPixels() const
+    {
+        return pixels.data();
+    }
+
+    void ClearBackground(Color color)
+    {
+        std::fill(pixels.begin(), pixels.end(), color);
+    }
+
+    // Only BLEND_ALPHA and BLEND_ALPHA_PREMULTIPLY are supported, other modes blend as BLEND_ALPHA
+    void BeginBlendMode(int mode)
+    {
+        blendMode = mode;
+    }
+
+    void EndBlendMode()
+    {
+        blendMode = BLEND_ALPHA;
+    }
+
+    void DrawRectangle(int posX, int posY, int recWidth, int recHeight, Color color)
+    {
+        FillRect(posX, posY, posX + recWidth, posY + recHeight, color);
+    }
+
+    void DrawRectangleRec(Rectangle rec, Color color)
+    {
+        int x0, x1, y0, y1;
+        CoveredRange(rec.x, rec.width, width, &x0, &x1);
+        CoveredRange(rec.y, rec.height, height, &y0, &y1);
+        FillRect(x0, y0, x1, y1, color);
+    }
+
+    // One pixel wide outline inside the rectangle
+    void DrawRectangleLines(int posX, int posY, int recWidth, int recHeight, Color color)
+    {
+        if ((recWidth <= 0) || (recHeight <= 0)) return;
+
+        FillRect(posX, posY, posX + recWidth, posY + 1, color);
+        if (recHeight > 1) FillRect(posX, posY + recHeight - 1, posX + recWidth, posY + recHeight, color);
+        FillRect(posX, posY + 1, posX + 1, posY + recHeight - 1, color);
+        if (recWidth > 1) FillRect(posX + recWidth - 1, posY + 1, posX + recWidth, posY + recHeight - 1, color);
+    }
+
+    // Same split into four rectangles as raylib
+    void DrawRectangleLinesEx(Rectangle rec, float lineThick, Color color)
+    {
+        if ((lineThick > rec.width) || (lineThick > rec.height))
+        {
+            if (rec.width > rec.height) lineThick = rec.height/2;
+            else if (rec.width < rec.height) lineThick = rec.width/2;
+        }
+
+        DrawRectangleRec(Rectangle{ rec.x, rec.y, rec.width, lineThick }, color);
+        DrawRectangleRec(Rectangle{ rec.x, rec.y + rec.height - lineThick, rec.width, lineThick }, color);
+        DrawRectangleRec(Rectangle{ rec.x, rec.y + lineThick, lineThick, rec.height - lineThick*2 }, color);
+        DrawRectangleRec(Rectangle{ rec.x + rec.width - lineThick, rec.y + lineThick, lineThick, rec.height - lineThick*2 }, color);
+    }
+
+    // Nearest-neighbour blit like raylib's default point filter. A negative source width or height
+    // flips the frame, and rotation turns dest clockwise around origin, as with DrawTexturePro
+    void DrawTexturePro(const SoftTexture& texture, Rectangle source, Rectangle dest, Vector2 origin, float rotation, Color tint)
+    {
+        if (texture.pixels.empty() || (dest.width <= 0) || (dest.height <= 0)) return;
+
+        if (rotation != 0.0f)
+        {
+            DrawTextureRotated(texture, source, dest, origin, rotation, tint);
+            return;
+        }
+
+        const bool flipX = (source.width < 0);
+        const bool flipY = (source.height < 0);
+        if (flipX) source.width = -source.width;
+        if (flipY) source.height = -source.height;
+
+        dest.x -= origin.x;
+        dest.y -= origin.y;
+
+        int x0, x1, y0, y1;
+        CoveredRange(dest.x, dest.width, width, &x0, &x1);
+        CoveredRange(dest.y, dest.height, height, &y0, &y1);
+        if ((x0 >= x1) || (y0 >= y1)) return;
+
+        // Texture column of each destination column, sampled at pixel centers
+        columnMap.resize(x1 - x0);
+        for (int x = x0; x < x1; x++)
+        {
+            float u = (x + 0.5f - dest.x)/dest.width;
+            if (flipX) u = 1.0f - u;
+
+            const int column = static_cast<int>(std::floor(source.x + u*source.width));
+            columnMap[x - x0] = std::max(0, std::min(column, texture.width - 1));
+        }
+
+        const bool tinted = (tint.r != 255) || (tint.g != 255) || (tint.b != 255) || (tint.a != 255);
+        const bool premultiplied = (blendMode == BLEND_ALPHA_PREMULTIPLY);
+
+        pool.Run(y1 - y0, x1 - x0, [&](int first, int end)
+        {
+            Color span[SOFT_RENDER_SPAN];
+
+            for (int y = y0 + first; y < y0 + end; y++)
+            {
+                float v = (y + 0.5f - dest.y)/dest.height;
+                if (flipY) v = 1.0f - v;
+
+                const int sourceRow = std::max(0, std::min(static_cast<int>(std::floor(source.y + v*source.height)), texture.height - 1));
+                const Color* src = texture.pixels.data() + static_cast<size_t>(sourceRow)*texture.width;
+                Color* row = pixels.data() + static_cast<size_t>(y)*width;
+
+                for (int x = x0; x < x1; x += SOFT_RENDER_SPAN)
+                {
+                    const int count = std::min(SOFT_RENDER_SPAN, x1 - x);
+                    const int* columns = columnMap.data() + (x - x0);
+
+                    for (int i = 0; i < count; i++) span[i] = src[columns[i]];
+
+                    if (tinted) TintSpan(span, count, tint);
+                    BlendSpan(row + x, span, count, premultiplied);
+                }
+            }
+        });
+    }
+
+    // Copy of the framebuffer as an RGBA8 image, e.g. for ExportImage()
+    Image ToImage() const
+    {
+        Image image = { 0 };
+        image.width = width;
+        image.height = height;
+        image.mipmaps = 1;
+        image.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8;
+        image.data = RL_MALLOC(pixels.size()*sizeof(Color));
+        memcpy(image.data, pixels.data(), pixels.size()*sizeof(Color));
+        return image;
+    }
+};
+
+// The same calls forwarded to raylib, so drawing code written against a canvas can target either backend
+struct GpuCanvas
+{
+    void ClearBackground(Color color)
+    {
+        ::ClearBackground(color);
+    }
+
+    void BeginBlendMode(int mode)
+    {
+        ::BeginBlendMode(mode);
+    }
+
+    void EndBlendMode()
+    {
+        ::EndBlendMode();
+    }
+
+    void DrawRectangle(int posX, int posY, int recWidth, int recHeight, Color color)
+    {
+        ::DrawRectangle(posX, posY, recWidth, recHeight, color);
+    }
+
+    void DrawRectangleRec(Rectangle rec, Color color)
+    {
+        ::DrawRectangleRec(rec, color);
+    }
+
+    void DrawRectangleLines(int posX, int posY, int recWidth, int recHeight, Color color)
+    {
+        ::DrawRectangleLines(posX, posY, recWidth, recHeight, color);
+    }
+
+    void DrawRectangleLinesEx(Rectangle rec, float lineThick, Color color)
+    {
+        ::DrawRectangleLinesEx(rec, lineThick, color);
+    }
+
+    void DrawTexturePro(Texture2D texture, Rectangle source, Rectangle dest, Vector2 origin, float rotation, Color tint)
+    {
+        ::DrawTexturePro(texture, source, dest, origin, rotation, tint);
+    }
+};
+
+//----------------------------------------------------------------------------------
+// Validation
+//----------------------------------------------------------------------------------
+
+// How far a rendered image is from a reference
+struct ImageDiff
+{
+    int maxError = 0;           // Largest per-channel difference
+    int mismatched = 0;         // Pixels with a channel differing by more than the tolerance
+    int pixelCount = 0;
+    double meanError = 0.0;     // Mean per-channel difference
+};
+
+// Compare two images of the same size as RGBA8, false if they cannot be compared
+inline bool CompareImages(const Image& image, const Image& reference, int tolerance, ImageDiff* diff)
+{
+    *diff = ImageDiff();
+    if ((image.data == nullptr) || (reference.data == nullptr) || (image.width != reference.width) || (image.height != reference.height)) return false;
+
+    const SoftTexture a = LoadSoftTexture(image);
+    const SoftTexture b = LoadSoftTexture(reference);
+    if (a.pixels.empty() || b.pixels.empty()) return false;
+
+    unsigned long long errorSum = 0;
+    diff->pixelCount = static_cast<int>(a.pixels.size());
+
+    for (size_t i = 0; i < a.pixels.size(); i++)
+    {
+        const unsigned char* pa = &a.pixels[i].r;
+        const unsigned char* pb = &b.pixels[i].r;
+
+        int pixelError = 0;
+        for (int c = 0; c < 4; c++)
+        {
+            const int error = std::abs(pa[c] - pb[c]);
+            pixelError = std::max(pixelError, error);
+            errorSum += error;
+        }
+
+        diff->maxError = std::max(diff->maxError, pixelError);
+        if (pixelError > tolerance) diff->mismatched++;
+    }
+
+    diff->meanError = static_cast<double>(errorSum)/(a.pixels.size()*4);
+    return true;
+}
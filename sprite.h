@@ -1,36 +1,65 @@
 #pragma once
 
 #include "raylib.h"
+#include "frame_dedup.h"
+#include "pixel_pipeline.h"
+#include "soft_render.h"
+#include "frame_table.h"
+#include "frame_mask.h"
+#include "memory_budget.h"
 
-class Sprite
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+// What the renderer needs to draw one sprite frame
+struct SpriteSnapshot
 {
-private:
     Vector2 position;
     Rectangle frameRec;
-    Texture2D spriteSheet;
+    float frameScale;
+    float frameFacing;
+    int currentFrame;
+    unsigned int frameStep;     // Counts every frame change, so a viewer can tell which frames it never showed
+    float frameMs;              // How long the current frame should stay on screen
+};
 
+// Animation state of a sprite sheet, kept apart from the texture so it can be stepped off the main thread
+struct SpriteAnimation
+{
+    Vector2 position;
+    Rectangle frameRec;
+
+    int sheetWidth;
     int frameWidth;
     int frameHeight;
     int currentFrame;
+    unsigned int frameStep;
+    float frameMs;
     int frameCounter;
     float frameSpeed;
     float frameScale;
     float frameFacing;
+    float timeAccumulator;
 
     int frameColumns;
     int frameRows;
 
-public:
-    Sprite(Vector2 position_, const char* spriteSheetPath_, int frameColumns_, int frameRows_, float frameFacing_)
+    // Frame table playback
+    int timelineTag;
+    int timelineDirection;
+    float timelineMs;
+
+    void Init(Vector2 position_, int sheetWidth_, int sheetHeight_, int frameColumns_, int frameRows_, float frameFacing_)
     {
-        spriteSheet = LoadTexture(spriteSheetPath_);
         position = position_;
+        sheetWidth = sheetWidth_;
 
         frameColumns = frameColumns_;
         frameRows = frameRows_;
 
-        frameWidth = spriteSheet.width/frameColumns_;
-        frameHeight = spriteSheet.height/frameRows_;
+        frameWidth = sheetWidth_/frameColumns_;
+        frameHeight = sheetHeight_/frameRows_;
 
         frameRec = {
             0, 0,
@@ -39,45 +68,23 @@ public:
         };
 
         currentFrame = 0;
+        frameStep = 0;
         frameCounter = 0;
         frameSpeed = 8.0f;
+        frameMs = 1000.0f/frameSpeed;
         frameScale = 2.0f;
         frameFacing = frameFacing_;
-    }
-
-    ~Sprite()
-    {
-        UnloadTexture(spriteSheet);
-    }
+        timeAccumulator = 0.0f;
 
-    int GetCurrentFrame() const
-    {
-        return currentFrame;
+        timelineTag = -2;
+        timelineDirection = 1;
+        timelineMs = 0.0f;
     }
 
-    Texture2D GetTexture() const
+    // Advance by one update; tickRate is the number of updates per second and deltaTime the seconds since the last one
+    void Step(int tickRate, float deltaTime, Vector2 position_, float frameScale_, float frameSpeed_, int selectedRow_, float frameFacing_, int totalFrames_, bool advanceRow)
     {
-        return spriteSheet;
-    }
-
-    Rectangle GetFrameRec() const
-    {
-        return frameRec;
-    }
-
-    void Reset(float frameScale_ = 1.0f)
-    {
-        currentFrame = 0;
-        frameCounter = 0;
-        frameSpeed = 8.0f;
-        frameScale = frameScale_;
-    }
-
-    float timeAccumulator = 0.0f;
-
-    void Update(Vector2 position_, float frameScale_, float frameSpeed_, int selectedRow_, float frameFacing_, int totalFrames_, bool advanceRow)
-    {
-        const int framesPerRow = (!advanceRow) ? spriteSheet.width/frameWidth*totalFrames_/frameColumns : spriteSheet.width/frameWidth*10/10;
+        const int framesPerRow = (!advanceRow) ? sheetWidth/frameWidth*totalFrames_/frameColumns : sheetWidth/frameWidth*10/10;
 
         if (!advanceRow)
         {
@@ -85,11 +92,13 @@ public:
             frameSpeed = frameSpeed_;
             frameFacing = frameFacing_;
             position = position_;
+            frameMs = 1000.0f/frameSpeed;
 
             frameCounter++;
-            if (frameCounter >= (GetFPS()/frameSpeed))
+            if (frameCounter >= (tickRate/frameSpeed))
             {
                 currentFrame++;
+                frameStep++;
                 if (currentFrame >= framesPerRow) currentFrame = 0;
 
                 const int row = selectedRow_;
@@ -107,15 +116,17 @@ public:
             frameFacing = frameFacing_;
             position = position_;
 
-            // Get current FPS and calculate animation speed
-            float animationFPS = static_cast<float>(GetFPS());
+            // Advance one frame per update
+            float animationFPS = static_cast<float>(tickRate);
             float secondsPerFrame = 1.0f/animationFPS;
+            frameMs = secondsPerFrame*1000.0f;
 
-            timeAccumulator += GetFrameTime();
+            timeAccumulator += deltaTime;
 
             if (timeAccumulator >= secondsPerFrame)
             {
                 currentFrame++;
+                frameStep++;
                 if (currentFrame >= framesPerRow) currentFrame = 0;
                 timeAccumulator -= secondsPerFrame;
             }
@@ -128,24 +139,551 @@ public:
         }
     }
 
-    void Draw() const
+    // Advance through a frame table by elapsed time, showing each frame for its own duration.
+    // tag picks the range and direction; an index that is not a tag plays every frame forward
+    void StepTimeline(const FrameTable& table, int tag, float deltaTime, Vector2 position_, float frameScale_, float frameSpeed_, float frameFacing_)
     {
-        const Rectangle source{
-            frameRec.x, frameRec.y,
-            frameRec.width*frameFacing,
-            frameRec.height
+        frameScale = frameScale_;
+        frameFacing = frameFacing_;
+        position = position_;
+
+        int from, to;
+        FrameTagDirection direction;
+        table.GetRange(tag, &from, &to, &direction);
+
+        const bool backwards = (direction == FrameTagDirection::Reverse) || (direction == FrameTagDirection::PingPongReverse);
+
+        // Frames without a duration of their own play at frameSpeed
+        const float defaultMs = (frameSpeed_ > 0.0f) ? 1000.0f/frameSpeed_ : 1000.0f;
+        auto durationOf = [&](int frame)
+        {
+            const float durationMs = table.GetFrame(frame).durationMs;
+            return std::max((durationMs > 0.0f) ? durationMs : defaultMs, 1.0f);
         };
 
-        DrawTexturePro(
-            spriteSheet,
-            source,
-            Rectangle{
-            position.x, position.y,
-                frameRec.width*frameScale,
-                frameRec.height*frameScale
-            },
-            Vector2{0, 0}, 0.0f,
-            WHITE
-        );
-    }
-};
\ No newline at end of file
+        if ((tag != timelineTag) || (currentFrame < from) || (currentFrame > to))
+        {
+            timelineTag = tag;
+            timelineDirection = backwards ? -1 : 1;
+            timelineMs = 0.0f;
+            currentFrame = backwards ? to : from;
+            frameStep++;
+        }
+
+        timelineMs += deltaTime*1000.0f;
+
+        // Frames shorter than a step are skipped over, but never more than one pass of the range
+        for (int passed = 0; passed <= to - from; passed++)
+        {
+            const float duration = durationOf(currentFrame);
+            if (timelineMs < duration) break;
+            timelineMs -= duration;
+
+            if (from == to) continue;
+            frameStep++;
+
+            if ((direction == FrameTagDirection::Forward) || (direction == FrameTagDirection::Reverse))
+            {
+                currentFrame += timelineDirection;
+                if (currentFrame > to) currentFrame = from;
+                else if (currentFrame < from) currentFrame = to;
+            }
+            else
+            {
+                if ((currentFrame + timelineDirection > to) || (currentFrame + timelineDirection < from)) timelineDirection = -timelineDirection;
+                currentFrame += timelineDirection;
+            }
+        }
+
+        frameMs = durationOf(currentFrame);
+        timelineMs = std::min(timelineMs, frameMs);
+        frameRec = table.GetFrame(currentFrame).source;
+    }
+
+    SpriteSnapshot GetSnapshot() const
+    {
+        return SpriteSnapshot{position, frameRec, frameScale, frameFacing, currentFrame, frameStep, frameMs};
+    }
+};
+
+// How a sheet is prepared before it is uploaded
+struct SpriteLoadOptions
+{
+    bool compactDuplicates = false;  // Upload only unique cells, duplicates are remapped onto them
+    bool premultiplyAlpha = false;   // Avoids dark fringes when frames are filtered while scaled
+    PixelPackMode packMode = PixelPackMode::Keep;
+    int packTolerance = 0;           // Largest per-channel error accepted when packing, 0 is lossless
+    bool uploadTexture = true;       // Off when there is no GL context, e.g. headless rendering
+    bool deferUpload = false;        // Keep the prepared sheet for UploadTexture(), so the rest can be built off the GL thread
+    bool keepSoftTexture = false;    // Keep a CPU copy of the sheet for SoftCanvas
+    bool buildMasks = true;          // Opacity masks and hitboxes for picking and overlap tests
+    int sourceShrink = 1;            // The sheet was downsampled by this to fit the memory budget, it is drawn this much larger
+    std::shared_ptr<const FrameTable> frameTable;   // Placed frames, durations and tags, when the sheet came with them
+};
+
+class Sprite
+{
+private:
+    Texture2D spriteSheet;
+    SpriteAnimation animation;
+
+    // Size of the sheet as authored, the texture is smaller when duplicates were compacted away
+    int sheetWidth;
+    int sheetHeight;
+    float sourceShrink;
+
+    // Cell of the sheet grid -> cell of the texture grid holding its pixels
+    std::vector<int> cellSource;
+    int frameCount;
+    int uniqueFrameCount;
+    size_t duplicateBytes;
+    size_t bytesSaved;
+    bool compacted;
+
+    PixelPipelineStats pixelStats;
+
+    SoftTexture softSheet;
+
+    // Prepared sheet waiting for UploadTexture(), when the upload was deferred
+    Image pendingUpload;
+
+    // Per-frame durations and tags, when the sheet came with them
+    std::shared_ptr<const FrameTable> frameTable;
+
+    // One per table entry, or per grid cell without a table
+    FrameMaskSet masks;
+
+    MemoryCharge memoryCharge{ MemoryPool::Sheet };
+
+    void UpdateMemoryCharge()
+    {
+        const SheetMemory memory = GetMemory();
+        memoryCharge.Set(memory.GetCpuBytes(), memory.textureBytes);
+    }
+
+    // Where a frame's pixels start inside its box: the trim offset, mirrored when facing left
+    Vector2 GetTrimOffset(const SpriteSnapshot& snapshot, const FrameEntry* entry, float width) const
+    {
+        if (entry == nullptr) return Vector2{0, 0};
+
+        const float boxWidth = (entry->sourceSize.x > 0) ? entry->sourceSize.x : width;
+        return Vector2{ (snapshot.frameFacing < 0) ? boxWidth - entry->trimOffset.x - width : entry->trimOffset.x, entry->trimOffset.y };
+    }
+
+public:
+    Sprite(Vector2 position_, const char* spriteSheetPath_, int frameColumns_, int frameRows_, float frameFacing_, const SpriteLoadOptions& options_ = SpriteLoadOptions())
+        : Sprite(position_, LoadImage(spriteSheetPath_), frameColumns_, frameRows_, frameFacing_, options_)
+    {
+    }
+
+    // Takes ownership of an already decoded sheet, e.g. one decoded ahead of time by the prefetcher
+    Sprite(Vector2 position_, Image spriteSheetImage_, int frameColumns_, int frameRows_, float frameFacing_, const SpriteLoadOptions& options_ = SpriteLoadOptions())
+    {
+        sheetWidth = spriteSheetImage_.width;
+        sheetHeight = spriteSheetImage_.height;
+        sourceShrink = static_cast<float>(std::max(options_.sourceShrink, 1));
+        animation.Init(position_, sheetWidth, sheetHeight, frameColumns_, frameRows_, frameFacing_);
+
+        frameTable = options_.frameTable;
+
+        // Built before compaction and packing change the layout
+        if (options_.buildMasks)
+        {
+            std::vector<FrameMaskSource> sources;
+            if (frameTable && (frameTable->GetFrameCount() > 0))
+            {
+                for (int i = 0; i < frameTable->GetFrameCount(); i++) sources.push_back(FrameMaskSource{ frameTable->GetFrame(i).source, frameTable->GetFrame(i).rotated });
+            }
+            else if ((animation.frameWidth > 0) && (animation.frameHeight > 0))
+            {
+                for (int i = 0; i < frameColumns_*frameRows_; i++)
+                {
+                    const Rectangle cell{ static_cast<float>((i % frameColumns_)*animation.frameWidth), static_cast<float>((i/frameColumns_)*animation.frameHeight),
+                                          static_cast<float>(animation.frameWidth), static_cast<float>(animation.frameHeight) };
+                    sources.push_back(FrameMaskSource{ cell, false });
+                }
+            }
+
+            masks.Build(spriteSheetImage_, sources);
+        }
+
+        const FrameDedup dedup = FindDuplicateFrames(spriteSheetImage_, frameColumns_, frameRows_);
+        frameCount = dedup.cellCount;
+        uniqueFrameCount = dedup.uniqueCount;
+        duplicateBytes = dedup.GetBytesSaved();
+        bytesSaved = 0;
+        compacted = false;
+        cellSource = dedup.cellSource;
+
+        if (options_.compactDuplicates && (dedup.uniqueCount < dedup.cellCount))
+        {
+            Image compact = BuildCompactSheet(spriteSheetImage_, dedup, frameColumns_);
+            bytesSaved = GetPixelDataSize(sheetWidth, sheetHeight, spriteSheetImage_.format) - GetPixelDataSize(compact.width, compact.height, compact.format);
+
+            UnloadImage(spriteSheetImage_);
+            spriteSheetImage_ = compact;
+
+            cellSource = dedup.cellUnique;
+            compacted = true;
+        }
+
+        if (frameCount > 0) TraceLog(LOG_INFO, "SPRITE: %d frames, %d unique, %zu duplicate bytes, %zu texture bytes saved", frameCount, uniqueFrameCount, duplicateBytes, bytesSaved);
+
+        pixelStats = ProcessSheetPixels(&spriteSheetImage_, options_.premultiplyAlpha, options_.packMode, options_.packTolerance);
+
+        spriteSheet = Texture2D{ 0 };
+        pendingUpload = Image{ 0 };
+        if (options_.keepSoftTexture) softSheet = LoadSoftTexture(spriteSheetImage_);
+
+        if (options_.deferUpload)
+        {
+            pendingUpload = spriteSheetImage_;
+            UpdateMemoryCharge();
+            return;
+        }
+
+        if (options_.uploadTexture) spriteSheet = LoadTextureFromImage(spriteSheetImage_);
+        UnloadImage(spriteSheetImage_);
+        UpdateMemoryCharge();
+    }
+
+    ~Sprite()
+    {
+        if (spriteSheet.id != 0) UnloadTexture(spriteSheet);
+        if (pendingUpload.data != nullptr) UnloadImage(pendingUpload);
+    }
+
+    Sprite(const Sprite&) = delete;
+    Sprite& operator=(const Sprite&) = delete;
+
+    // Create the texture of a sheet loaded with deferUpload, on the thread that owns the GL context
+    void UploadTexture()
+    {
+        if (pendingUpload.data == nullptr) return;
+
+        spriteSheet = LoadTextureFromImage(pendingUpload);
+        UnloadImage(pendingUpload);
+        pendingUpload = Image{ 0 };
+        UpdateMemoryCharge();
+    }
+
+    // What the sheet holds now, on the CPU and the GPU
+    SheetMemory GetMemory() const
+    {
+        SheetMemory memory = { 0, 0, 0, 0, 0 };
+        if (pendingUpload.data != nullptr) memory.decodedBytes = GetPixelDataSize(pendingUpload.width, pendingUpload.height, pendingUpload.format);
+        if (spriteSheet.id != 0) memory.textureBytes = GetPixelDataSize(spriteSheet.width, spriteSheet.height, spriteSheet.format);
+        memory.softBytes = softSheet.pixels.capacity()*sizeof(Color);
+        memory.maskBytes = masks.GetByteSize();
+        memory.tableBytes = cellSource.capacity()*sizeof(int) + (frameTable ? frameTable->GetByteSize() : 0);
+        return memory;
+    }
+
+    int GetCurrentFrame() const
+    {
+        return animation.currentFrame;
+    }
+
+    Texture2D GetTexture() const
+    {
+        return spriteSheet;
+    }
+
+    void SetFrameTable(const std::shared_ptr<const FrameTable>& frameTable_)
+    {
+        frameTable = frameTable_;
+        UpdateMemoryCharge();
+    }
+
+    const std::shared_ptr<const FrameTable>& GetFrameTable() const
+    {
+        return frameTable;
+    }
+
+    // Table entry of a timeline frame, null without a table
+    const FrameEntry* GetFrameEntry(int frame) const
+    {
+        if (!frameTable || (frame < 0) || (frame >= frameTable->GetFrameCount())) return nullptr;
+        return &frameTable->GetFrame(frame);
+    }
+
+    const FrameMaskSet& GetMasks() const
+    {
+        return masks;
+    }
+
+    // Mask of the frame a snapshot shows, -1 when there is none
+    int GetMaskIndex(const SpriteSnapshot& snapshot) const
+    {
+        int index = snapshot.currentFrame;
+        if (!frameTable)
+        {
+            if ((animation.frameWidth <= 0) || (animation.frameHeight <= 0)) return -1;
+            index = static_cast<int>(snapshot.frameRec.y)/animation.frameHeight*animation.frameColumns + static_cast<int>(snapshot.frameRec.x)/animation.frameWidth;
+        }
+
+        return ((index >= 0) && (index < masks.GetFrameCount())) ? index : -1;
+    }
+
+    // Pixels of a downsampled sheet are drawn larger, so it keeps the size it was authored at
+    float GetDrawScale(const SpriteSnapshot& snapshot) const
+    {
+        return snapshot.frameScale*sourceShrink;
+    }
+
+    // Screen rectangle the frame's upright pixels cover when drawn
+    Rectangle GetDrawnBox(const SpriteSnapshot& snapshot) const
+    {
+        const FrameEntry* entry = GetFrameEntry(snapshot.currentFrame);
+        const bool rotated = (entry != nullptr) && entry->rotated;
+        const float width = rotated ? snapshot.frameRec.height : snapshot.frameRec.width;
+        const float height = rotated ? snapshot.frameRec.width : snapshot.frameRec.height;
+        const Vector2 offset = GetTrimOffset(snapshot, entry, width);
+        const float scale = GetDrawScale(snapshot);
+
+        return Rectangle{ snapshot.position.x + offset.x*scale, snapshot.position.y + offset.y*scale, width*scale, height*scale };
+    }
+
+    // Whether a screen point lands on an opaque pixel of the drawn frame, and which upright frame pixel it is
+    bool PickPixel(const SpriteSnapshot& snapshot, Vector2 point, int* pixelX, int* pixelY) const
+    {
+        const int mask = GetMaskIndex(snapshot);
+        const Rectangle box = GetDrawnBox(snapshot);
+        const float scale = GetDrawScale(snapshot);
+        if ((mask < 0) || (scale <= 0.0f) || !CheckCollisionPointRec(point, box)) return false;
+
+        int x = static_cast<int>((point.x - box.x)/scale);
+        const int y = static_cast<int>((point.y - box.y)/scale);
+        if (snapshot.frameFacing < 0) x = masks.GetMask(mask).width - 1 - x;
+
+        *pixelX = x;
+        *pixelY = y;
+        return masks.TestPixel(mask, x, y);
+    }
+
+    // The sheet as each canvas draws it
+    Texture2D GetSheet(const GpuCanvas&) const
+    {
+        return spriteSheet;
+    }
+
+    const SoftTexture& GetSheet(const SoftCanvas&) const
+    {
+        return softSheet;
+    }
+
+    bool HasSoftTexture() const
+    {
+        return !softSheet.pixels.empty();
+    }
+
+    // Read the uploaded texture back when the sheet was loaded without a CPU copy
+    void LoadSoftTextureFromGpu()
+    {
+        if (HasSoftTexture() || (spriteSheet.id == 0)) return;
+
+        Image image = LoadImageFromTexture(spriteSheet);
+        softSheet = LoadSoftTexture(image);
+        UnloadImage(image);
+    }
+
+    Rectangle GetFrameRec() const
+    {
+        return animation.frameRec;
+    }
+
+    int GetSheetWidth() const
+    {
+        return sheetWidth;
+    }
+
+    int GetSheetHeight() const
+    {
+        return sheetHeight;
+    }
+
+    int GetFrameCount() const
+    {
+        return frameCount;
+    }
+
+    int GetUniqueFrameCount() const
+    {
+        return uniqueFrameCount;
+    }
+
+    // Size of all duplicate frames in the sheet
+    size_t GetDuplicateBytes() const
+    {
+        return duplicateBytes;
+    }
+
+    // Texture memory actually saved by compacting, the last compact row is padded to full width
+    size_t GetBytesSaved() const
+    {
+        return bytesSaved;
+    }
+
+    bool IsCompacted() const
+    {
+        return compacted;
+    }
+
+    // Premultiplied sheets must be drawn with BLEND_ALPHA_PREMULTIPLY
+    bool IsPremultiplied() const
+    {
+        return pixelStats.premultiplied;
+    }
+
+    const PixelPipelineStats& GetPixelStats() const
+    {
+        return pixelStats;
+    }
+
+    // Where a frame of the sheet grid actually lives in the texture
+    Rectangle GetSourceRec(const Rectangle& frameRec) const
+    {
+        const int frameWidth = animation.frameWidth;
+        const int frameHeight = animation.frameHeight;
+        const int columns = animation.frameColumns;
+
+        // Without compaction a duplicate's own pixels are as good as the first copy's
+        if (!compacted || cellSource.empty() || (frameWidth <= 0) || (frameHeight <= 0)) return frameRec;
+
+        const int col = static_cast<int>(frameRec.x)/frameWidth;
+        const int row = static_cast<int>(frameRec.y)/frameHeight;
+        const int cell = row*columns + col;
+        if ((col >= columns) || (cell < 0) || (cell >= static_cast<int>(cellSource.size()))) return frameRec;
+
+        const int source = cellSource[cell];
+        return Rectangle{
+            static_cast<float>((source % columns)*frameWidth),
+            static_cast<float>((source/columns)*frameHeight),
+            frameRec.width, frameRec.height
+        };
+    }
+
+    int GetFrameColumns() const
+    {
+        return animation.frameColumns;
+    }
+
+    int GetFrameRows() const
+    {
+        return animation.frameRows;
+    }
+
+    void Reset(float frameScale_ = 1.0f)
+    {
+        animation.currentFrame = 0;
+        animation.frameCounter = 0;
+        animation.frameSpeed = 8.0f;
+        animation.frameScale = frameScale_;
+    }
+
+    // A still frame of the sheet grid, for rendering outside the animation
+    SpriteSnapshot GetFrameSnapshot(Vector2 position_, int row_, int frame_, float frameScale_, float frameFacing_) const
+    {
+        const Rectangle frameRec{
+            static_cast<float>(frame_*animation.frameWidth),
+            static_cast<float>(row_*animation.frameHeight),
+            static_cast<float>(animation.frameWidth),
+            static_cast<float>(animation.frameHeight)
+        };
+
+        return SpriteSnapshot{position_, frameRec, frameScale_, frameFacing_, frame_, 0, 0.0f};
+    }
+
+    // The frame offset_ frames before (negative) or after a snapshot's, wrapping within what is playing:
+    // the tag's range with a frame table, the first rowFrames_ columns of the snapshot's row otherwise.
+    // Ping-pong tags are taken in sheet order
+    SpriteSnapshot GetNeighbourSnapshot(const SpriteSnapshot& snapshot, int offset_, int tag_, int rowFrames_) const
+    {
+        SpriteSnapshot neighbour = snapshot;
+
+        if (frameTable && (frameTable->GetFrameCount() > 0))
+        {
+            int from, to;
+            FrameTagDirection direction;
+            frameTable->GetRange(tag_, &from, &to, &direction);
+
+            const bool backwards = (direction == FrameTagDirection::Reverse) || (direction == FrameTagDirection::PingPongReverse);
+            const int count = to - from + 1;
+            const int step = backwards ? -offset_ : offset_;
+            const int frame = from + ((snapshot.currentFrame - from + step) % count + count) % count;
+
+            neighbour.currentFrame = frame;
+            neighbour.frameRec = frameTable->GetFrame(frame).source;
+            return neighbour;
+        }
+
+        if (animation.frameWidth <= 0) return neighbour;
+
+        const int count = std::min(std::max(rowFrames_, 1), animation.frameColumns);
+        const int column = static_cast<int>(snapshot.frameRec.x)/animation.frameWidth;
+        const int frame = ((column + offset_) % count + count) % count;
+
+        neighbour.currentFrame = frame;
+        neighbour.frameRec.x = static_cast<float>(frame*animation.frameWidth);
+        return neighbour;
+    }
+
+    void Draw() const
+    {
+        Draw(animation.GetSnapshot());
+    }
+
+    // Draw a frame published by the simulation thread
+    void Draw(const SpriteSnapshot& snapshot) const
+    {
+        GpuCanvas canvas;
+        Draw(canvas, snapshot);
+    }
+
+    // tint multiplies the sheet's colours, alpha included
+    template <typename Canvas>
+    void Draw(Canvas& canvas, const SpriteSnapshot& snapshot, Color tint = WHITE) const
+    {
+        const Rectangle frameSource = GetSourceRec(snapshot.frameRec);
+        const FrameEntry* entry = GetFrameEntry(snapshot.currentFrame);
+        const bool rotated = (entry != nullptr) && entry->rotated;
+        const float scale = GetDrawScale(snapshot);
+
+        // A trimmed frame sits inside its untrimmed box
+        const Vector2 offset = GetTrimOffset(snapshot, entry, rotated ? frameSource.height : frameSource.width);
+
+        const Vector2 position{ snapshot.position.x + offset.x*scale, snapshot.position.y + offset.y*scale };
+
+        // A premultiplied sheet needs a premultiplied tint, or fading it out would brighten it
+        if (pixelStats.premultiplied)
+        {
+            tint = Color{ static_cast<unsigned char>(tint.r*tint.a/255), static_cast<unsigned char>(tint.g*tint.a/255),
+                          static_cast<unsigned char>(tint.b*tint.a/255), tint.a };
+            canvas.BeginBlendMode(BLEND_ALPHA_PREMULTIPLY);
+        }
+
+        if (!rotated)
+        {
+            canvas.DrawTexturePro(
+                GetSheet(canvas),
+                Rectangle{ frameSource.x, frameSource.y, frameSource.width*snapshot.frameFacing, frameSource.height },
+                Rectangle{ position.x, position.y, frameSource.width*scale, frameSource.height*scale },
+                Vector2{0, 0}, 0.0f,
+                tint
+            );
+        }
+        else
+        {
+            // Stored turned clockwise, so it is drawn turned back and a horizontal flip is a vertical one in the sheet
+            canvas.DrawTexturePro(
+                GetSheet(canvas),
+                Rectangle{ frameSource.x, frameSource.y, frameSource.width, frameSource.height*snapshot.frameFacing },
+                Rectangle{ position.x, position.y + frameSource.width*scale, frameSource.width*scale, frameSource.height*scale },
+                Vector2{0, 0}, -90.0f,
+                tint
+            );
+        }
+
+        if (pixelStats.premultiplied) canvas.EndBlendMode();
+    }
+};